@@ -0,0 +1,331 @@
+#include "baseline.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+namespace baseline
+{
+    namespace
+    {
+        std::string toLower(std::string_view value)
+        {
+            std::string result(value);
+            std::transform(result.begin(), result.end(), result.begin(), [](unsigned char ch)
+                           { return static_cast<char>(std::tolower(ch)); });
+            return result;
+        }
+
+        std::string trim(std::string_view value)
+        {
+            const auto begin = value.find_first_not_of(" \t\r\n");
+            if (begin == std::string_view::npos)
+            {
+                return {};
+            }
+            const auto end = value.find_last_not_of(" \t\r\n");
+            return std::string(value.substr(begin, end - begin + 1));
+        }
+
+        std::string urlDecode(const std::string &value)
+        {
+            std::string result;
+            result.reserve(value.size());
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] == '%' && i + 2 < value.size())
+                {
+                    std::string hex = value.substr(i + 1, 2);
+                    char ch = static_cast<char>(std::strtol(hex.c_str(), nullptr, 16));
+                    result.push_back(ch);
+                    i += 2;
+                }
+                else if (value[i] == '+')
+                {
+                    result.push_back(' ');
+                }
+                else
+                {
+                    result.push_back(value[i]);
+                }
+            }
+            return result;
+        }
+
+        std::unordered_map<std::string, std::string> parseParams(const std::string &data)
+        {
+            std::unordered_map<std::string, std::string> result;
+            size_t start = 0;
+            while (start < data.size())
+            {
+                const auto amp = data.find('&', start);
+                const auto token = data.substr(start, amp == std::string::npos ? std::string::npos : amp - start);
+                const auto eq = token.find('=');
+                if (eq != std::string::npos)
+                {
+                    std::string key = urlDecode(token.substr(0, eq));
+                    std::string value = urlDecode(token.substr(eq + 1));
+                    result[std::move(key)] = std::move(value);
+                }
+                else if (!token.empty())
+                {
+                    result[urlDecode(token)] = "";
+                }
+                if (amp == std::string::npos)
+                {
+                    break;
+                }
+                start = amp + 1;
+            }
+            return result;
+        }
+
+        std::string jsonEscape(const std::string &value)
+        {
+            std::ostringstream oss;
+            for (char ch : value)
+            {
+                switch (ch)
+                {
+                case '\"':
+                    oss << "\\\"";
+                    break;
+                case '\\':
+                    oss << "\\\\";
+                    break;
+                case '\n':
+                    oss << "\\n";
+                    break;
+                case '\r':
+                    oss << "\\r";
+                    break;
+                case '\t':
+                    oss << "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20)
+                    {
+                        oss << "\\u"
+                            << std::hex << std::setw(4) << std::setfill('0')
+                            << static_cast<int>(static_cast<unsigned char>(ch))
+                            << std::dec << std::setw(0);
+                    }
+                    else
+                    {
+                        oss << ch;
+                    }
+                }
+            }
+            return oss.str();
+        }
+
+        void writeAdJson(std::ostringstream &oss, const AdvertView &ad)
+        {
+            oss << '{';
+            oss << R"("id":)" << ad.id << ',';
+            oss << R"("title":")" << jsonEscape(ad.title) << R"(",)";
+            oss << R"("description":")" << jsonEscape(ad.description) << R"(",)";
+            {
+                std::ostringstream priceStream;
+                priceStream << std::fixed << std::setprecision(2) << ad.price;
+                oss << R"("price":)" << priceStream.str() << ',';
+            }
+            oss << R"("ownerName":")" << jsonEscape(ad.ownerName) << R"(",)";
+            oss << R"("createdAt":)" << static_cast<long long>(ad.createdAt) << ',';
+            oss << R"("mine":)" << (ad.mine ? "true" : "false") << ',';
+            if (ad.responsesCount)
+            {
+                oss << R"("responsesCount":)" << *ad.responsesCount << ',';
+            }
+            oss << R"("hasResponded":)" << (ad.hasResponded ? "true" : "false");
+            oss << '}';
+        }
+    }
+
+    ParseStatus parseRequest(const std::string &raw, HttpRequest &request, size_t &consumed)
+    {
+        const size_t headerEnd = raw.find("\r\n\r\n");
+        if (headerEnd == std::string::npos)
+        {
+            return ParseStatus::Incomplete;
+        }
+
+        request = HttpRequest{};
+        const auto headerSection = raw.substr(0, headerEnd);
+        std::istringstream stream(headerSection);
+        std::string startLine;
+        std::getline(stream, startLine);
+        if (!startLine.empty() && startLine.back() == '\r')
+        {
+            startLine.pop_back();
+        }
+
+        std::istringstream startLineStream(startLine);
+        startLineStream >> request.method >> request.rawTarget >> request.version;
+        if (request.rawTarget.empty())
+        {
+            return ParseStatus::Invalid;
+        }
+
+        const auto question = request.rawTarget.find('?');
+        if (question != std::string::npos)
+        {
+            request.path = request.rawTarget.substr(0, question);
+            request.query = parseParams(request.rawTarget.substr(question + 1));
+        }
+        else
+        {
+            request.path = request.rawTarget;
+        }
+        if (request.path.empty())
+        {
+            request.path = "/";
+        }
+
+        std::string headerLine;
+        while (std::getline(stream, headerLine))
+        {
+            if (!headerLine.empty() && headerLine.back() == '\r')
+            {
+                headerLine.pop_back();
+            }
+            if (headerLine.empty())
+            {
+                continue;
+            }
+            const auto colon = headerLine.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+            std::string key = toLower(headerLine.substr(0, colon));
+            std::string value = trim(headerLine.substr(colon + 1));
+            request.headers.emplace(std::move(key), std::move(value));
+        }
+
+        size_t contentLength = 0;
+        if (auto it = request.headers.find("content-length"); it != request.headers.end())
+        {
+            try
+            {
+                contentLength = static_cast<size_t>(std::stoul(it->second));
+            }
+            catch (...)
+            {
+                return ParseStatus::Invalid;
+            }
+        }
+
+        const size_t totalNeeded = headerEnd + 4 + contentLength;
+        if (raw.size() < totalNeeded)
+        {
+            return ParseStatus::Incomplete;
+        }
+        request.body = raw.substr(headerEnd + 4, contentLength);
+        consumed = totalNeeded;
+
+        if (auto it = request.headers.find("content-type");
+            it != request.headers.end() && it->second.find("application/x-www-form-urlencoded") != std::string::npos)
+        {
+            request.form = parseParams(request.body);
+        }
+
+        return ParseStatus::Complete;
+    }
+
+    std::string adsJson(const std::vector<AdvertView> &ads)
+    {
+        std::ostringstream oss;
+        oss << R"({"ads":[)";
+        bool first = true;
+        for (const auto &ad : ads)
+        {
+            if (!first)
+            {
+                oss << ',';
+            }
+            first = false;
+            writeAdJson(oss, ad);
+        }
+        oss << "]}";
+        return oss.str();
+    }
+
+    int routeIfChain(const std::string &method, const std::string &path, int &id)
+    {
+        if (method == "POST" && path == "/api/register")
+        {
+            return 0;
+        }
+        if (method == "POST" && path == "/api/login")
+        {
+            return 1;
+        }
+        if (method == "POST" && path == "/api/logout")
+        {
+            return 2;
+        }
+        if (method == "GET" && path == "/api/session")
+        {
+            return 3;
+        }
+        if (method == "GET" && path == "/api/ads")
+        {
+            return 4;
+        }
+        if (method == "GET" && path == "/api/ads/search")
+        {
+            return 5;
+        }
+        if (method == "GET" && path == "/api/ads/my-responses")
+        {
+            return 6;
+        }
+        if (method == "POST" && path == "/api/ads")
+        {
+            return 7;
+        }
+        if (method == "DELETE" && path.rfind("/api/ads/", 0) == 0)
+        {
+            const std::string idStr(path.substr(std::string("/api/ads/").size()));
+            if (!idStr.empty() && std::all_of(idStr.begin(), idStr.end(), ::isdigit))
+            {
+                id = std::stoi(idStr);
+                return 8;
+            }
+        }
+        if (method == "POST" && path.rfind("/api/ads/", 0) == 0)
+        {
+            const std::string suffix(path.substr(std::string("/api/ads/").size()));
+            const auto slash = suffix.find('/');
+            if (slash != std::string::npos)
+            {
+                const std::string idStr = suffix.substr(0, slash);
+                const std::string action = suffix.substr(slash + 1);
+                if (!idStr.empty() && std::all_of(idStr.begin(), idStr.end(), ::isdigit) && action == "respond")
+                {
+                    id = std::stoi(idStr);
+                    return 9;
+                }
+            }
+        }
+        if (method == "GET" && path.rfind("/api/ads/", 0) == 0)
+        {
+            const std::string suffix(path.substr(std::string("/api/ads/").size()));
+            const auto slash = suffix.find('/');
+            if (slash != std::string::npos)
+            {
+                const std::string idStr = suffix.substr(0, slash);
+                const std::string action = suffix.substr(slash + 1);
+                if (!idStr.empty() && std::all_of(idStr.begin(), idStr.end(), ::isdigit) && action == "responders")
+                {
+                    id = std::stoi(idStr);
+                    return 10;
+                }
+            }
+        }
+        return -1;
+    }
+}
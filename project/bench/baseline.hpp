@@ -0,0 +1,55 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <cstddef>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Code the server has since replaced, kept as it was so the benchmarks can
+// show what the replacement bought. Nothing outside bb_bench uses it.
+namespace baseline
+{
+    // The request as the istringstream parser produced it: owned strings and
+    // lower-cased header keys.
+    struct HttpRequest
+    {
+        std::string method;
+        std::string rawTarget;
+        std::string version;
+        std::string path;
+        std::unordered_map<std::string, std::string> headers;
+        std::unordered_map<std::string, std::string> query;
+        std::unordered_map<std::string, std::string> form;
+        std::string body;
+    };
+
+    // Parses one request from the front of `raw`, copying every part out of it.
+    ParseStatus parseRequest(const std::string &raw, HttpRequest &request, size_t &consumed);
+
+    // One advert of the /api/ads list with the viewer's fields resolved.
+    struct AdvertView
+    {
+        int id = 0;
+        std::string title;
+        std::string description;
+        double price = 0;
+        std::string ownerName;
+        std::time_t createdAt = 0;
+        bool mine = false;
+        std::optional<size_t> responsesCount;
+        bool hasResponded = false;
+    };
+
+    // The list as the ostringstream builder wrote it before JsonWriter.
+    std::string adsJson(const std::vector<AdvertView> &ads);
+
+    // handleApi's if-chain from before the route table, with each handler
+    // call replaced by returning its place in the chain (-1: no match, which
+    // includes a wrong method). `id` is set for the {id} routes.
+    int routeIfChain(const std::string &method, const std::string &path, int &id);
+}
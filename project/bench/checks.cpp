@@ -0,0 +1,170 @@
+#include "checks.hpp"
+
+#include "http.hpp"
+#include "json.hpp"
+#include "search.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    bool fail(std::string_view check, std::string_view what)
+    {
+        std::cerr << "check: " << check << ": " << what << std::endl;
+        return false;
+    }
+
+    ParseStatus parseOnce(const std::string &raw, HttpRequest &request)
+    {
+        HttpParser parser;
+        return parser.parse(raw, request);
+    }
+
+    // Content-Length is capped before it is added to the head size, and only
+    // one of them is accepted.
+    bool checkContentLength()
+    {
+        const std::string head = "POST /api/ads HTTP/1.1\r\nHost: localhost\r\n";
+        HttpRequest request;
+        bool ok = true;
+        if (parseOnce(head + "Content-Length: 18446744073709551615\r\n\r\nabc", request) != ParseStatus::TooLarge)
+        {
+            ok = fail("parser", "a Content-Length of 2^64-1 is not refused as too large");
+        }
+        if (parseOnce(head + "Content-Length: " + std::to_string(kMaxRequestBytes) + "\r\n\r\n", request) !=
+            ParseStatus::TooLarge)
+        {
+            ok = fail("parser", "a body that ends past kMaxRequestBytes is not refused as too large");
+        }
+        if (parseOnce(head + "Content-Length: 3\r\nContent-Length: 3\r\n\r\nabc", request) != ParseStatus::Invalid)
+        {
+            ok = fail("parser", "a repeated Content-Length is accepted");
+        }
+        if (parseOnce(head + "Content-Length: 3\r\ncontent-length: 300\r\n\r\nabc", request) != ParseStatus::Invalid)
+        {
+            ok = fail("parser", "conflicting Content-Length headers are accepted");
+        }
+        if (parseOnce(head + "Content-Length: 3\r\n\r\nabcGET", request) != ParseStatus::Complete ||
+            request.body != "abc")
+        {
+            ok = fail("parser", "a plain Content-Length body is not read");
+        }
+        return ok;
+    }
+
+    // Control characters other than \n, \r and \t come out as \u00XX, the
+    // way the server wrote them before JsonWriter.
+    bool checkJsonEscapes()
+    {
+        // The string's own terminator is left out; the embedded \0 is not.
+        constexpr char kInput[] = "a\"\\\b\f\n\r\t\x01\x1f\x7f\0";
+        std::string out;
+        appendJsonEscaped(out, std::string_view(kInput, sizeof(kInput) - 1));
+        const std::string_view expected = R"(a\"\\\u0008\u000c\n\r\t\u0001\u001f)"
+                                           "\x7f"
+                                           R"(\u0000)";
+        if (out != expected)
+        {
+            return fail("json", "escaped as " + out);
+        }
+        return true;
+    }
+
+    // fixed() writes every finite value in full, however large, and null
+    // for the rest.
+    bool checkJsonFixed()
+    {
+        bool ok = true;
+        for (const double value : {0.0, 12.5, -3.14159, 1e12, 1e60, 1e300, -std::numeric_limits<double>::max()})
+        {
+            char expected[400];
+            std::snprintf(expected, sizeof(expected), "%.2f", value);
+            std::string out;
+            JsonWriter(out).fixed(value, 2);
+            if (out != expected)
+            {
+                ok = fail("json", "fixed(" + std::string(expected) + ", 2) wrote " + out);
+            }
+        }
+        for (const double value : {std::nan(""), std::numeric_limits<double>::infinity()})
+        {
+            std::string out;
+            JsonWriter(out).fixed(value, 2);
+            if (out != "null")
+            {
+                ok = fail("json", "a non-finite value was written as " + out);
+            }
+        }
+        return ok;
+    }
+
+    // A prefix expands to all the words it starts. The best advert sits on
+    // the 65th of them, past where expansion used to stop; as the driver and
+    // as the other word of a two-word query it must still come first.
+    bool checkSearchPrefixes()
+    {
+        constexpr int kWords = 65;
+        SearchIndex index;
+        const std::time_t now = 1700000000;
+        for (int id = 1; id <= kWords; ++id)
+        {
+            char word[16];
+            std::snprintf(word, sizeof(word), "pref%03d", id);
+            const std::string tag = id > kWords - 6 ? " tag" : "";
+            if (id == kWords)
+            {
+                index.add(id, now, std::string(word) + " " + word, word + tag);
+            }
+            else
+            {
+                index.add(id, now, "advert", word + tag);
+            }
+        }
+        bool ok = true;
+        const auto hits = index.search("pref", 100, now);
+        if (hits.size() != kWords || hits.front().adId != kWords)
+        {
+            ok = fail("search", "\"pref\" does not reach all 65 expansions or misranks the last");
+        }
+        const auto tagged = index.search("pref tag", 100, now);
+        if (tagged.size() != 6 || tagged.front().adId != kWords)
+        {
+            ok = fail("search", "\"pref tag\" does not rank the 65th expansion first");
+        }
+        if (!index.search("pr", 100, now).empty())
+        {
+            ok = fail("search", "a two-character word is expanded as a prefix");
+        }
+        return ok;
+    }
+
+    struct Check
+    {
+        const char *name;
+        bool (*run)();
+    };
+
+    constexpr Check kChecks[] = {
+        {"parser/content_length", checkContentLength},
+        {"json/escapes", checkJsonEscapes},
+        {"json/fixed", checkJsonFixed},
+        {"search/prefix_expansions", checkSearchPrefixes},
+    };
+}
+
+bool runBehaviourChecks()
+{
+    bool ok = true;
+    for (const auto &check : kChecks)
+    {
+        const bool passed = check.run();
+        std::cout << (passed ? "ok     " : "FAILED ") << check.name << std::endl;
+        ok = ok && passed;
+    }
+    return ok;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Behaviour that must not regress, run by `bb_bench check` before the
+// allocation limits. Every failure is described on stderr; false if any.
+bool runBehaviourChecks();
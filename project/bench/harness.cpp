@@ -0,0 +1,163 @@
+#include "harness.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+
+    void *allocate(size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        if (void *data = std::malloc(size == 0 ? 1 : size))
+        {
+            return data;
+        }
+        throw std::bad_alloc();
+    }
+
+    void *allocateAligned(size_t size, std::align_val_t alignment)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        const auto align = static_cast<size_t>(alignment);
+        // aligned_alloc wants a multiple of the alignment.
+        const size_t rounded = (std::max<size_t>(size, 1) + align - 1) & ~(align - 1);
+        if (void *data = std::aligned_alloc(align, rounded))
+        {
+            return data;
+        }
+        throw std::bad_alloc();
+    }
+
+    struct Benchmark
+    {
+        const char *name;
+        BenchmarkFunction function;
+    };
+
+    std::vector<Benchmark> &registry()
+    {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+}
+
+// Every global allocation in bb_bench goes through these, so a benchmark can
+// report how often the code under test reaches the heap.
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void *operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void operator delete(void *data) noexcept { std::free(data); }
+void operator delete[](void *data) noexcept { std::free(data); }
+void operator delete(void *data, size_t) noexcept { std::free(data); }
+void operator delete[](void *data, size_t) noexcept { std::free(data); }
+void operator delete(void *data, std::align_val_t) noexcept { std::free(data); }
+void operator delete[](void *data, std::align_val_t) noexcept { std::free(data); }
+void operator delete(void *data, size_t, std::align_val_t) noexcept { std::free(data); }
+void operator delete[](void *data, size_t, std::align_val_t) noexcept { std::free(data); }
+
+uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void BenchmarkState::start()
+{
+    started_ = true;
+    allocationsAtStart_ = allocationCount();
+    startedAt_ = std::chrono::steady_clock::now();
+}
+
+void BenchmarkState::stop()
+{
+    elapsed_ = std::chrono::steady_clock::now() - startedAt_;
+    allocations_ = allocationCount() - allocationsAtStart_;
+}
+
+bool registerBenchmark(const char *name, BenchmarkFunction function)
+{
+    registry().push_back({name, function});
+    return true;
+}
+
+namespace
+{
+    template <typename Selected>
+    std::vector<BenchmarkResult> runSelected(Selected selected, std::chrono::milliseconds minTime)
+    {
+        constexpr uint64_t kMaxIterations = uint64_t(1) << 30;
+
+        std::printf("%-40s %12s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "MB/s");
+        std::vector<BenchmarkResult> results;
+        for (const auto &benchmark : registry())
+        {
+            if (!selected(std::string_view(benchmark.name)))
+            {
+                continue;
+            }
+
+            uint64_t iterations = 1;
+            while (true)
+            {
+                BenchmarkState state(iterations);
+                benchmark.function(state);
+                const auto elapsed = state.elapsed();
+                if (elapsed >= minTime || iterations >= kMaxIterations)
+                {
+                    const double nanosPerOp = static_cast<double>(elapsed.count()) / static_cast<double>(iterations);
+                    const double allocsPerOp = static_cast<double>(state.allocations()) / static_cast<double>(iterations);
+                    std::string throughput = "-";
+                    if (state.bytesPerIteration() > 0 && elapsed.count() > 0)
+                    {
+                        const double bytes = static_cast<double>(state.bytesPerIteration() * iterations);
+                        throughput = std::to_string(static_cast<long long>(bytes / 1e6 / (elapsed.count() / 1e9)));
+                    }
+                    std::printf("%-40s %12llu %12.1f %12.2f %12s  %s\n", benchmark.name,
+                                static_cast<unsigned long long>(iterations), nanosPerOp, allocsPerOp,
+                                throughput.c_str(), state.label().c_str());
+                    results.push_back({benchmark.name, iterations, nanosPerOp, allocsPerOp});
+                    break;
+                }
+                // Aim a little past the minimum time, growing at most tenfold per round.
+                const double perOp = std::max<double>(1.0, static_cast<double>(elapsed.count())) / static_cast<double>(iterations);
+                const double wanted = 1.2 * static_cast<double>(std::chrono::nanoseconds(minTime).count()) / perOp;
+                iterations = std::min<uint64_t>(kMaxIterations,
+                                                std::max<uint64_t>(iterations + 1,
+                                                                   std::min<double>(wanted, static_cast<double>(iterations) * 10)));
+            }
+        }
+        return results;
+    }
+}
+
+std::vector<BenchmarkResult> runBenchmarks(std::string_view filter, std::chrono::milliseconds minTime)
+{
+    return runSelected([filter](std::string_view name)
+                       { return name.find(filter) != std::string_view::npos; },
+                       minTime);
+}
+
+std::vector<BenchmarkResult> runBenchmarks(const std::vector<std::string_view> &names,
+                                           std::chrono::milliseconds minTime)
+{
+    return runSelected([&names](std::string_view name)
+                       { return std::find(names.begin(), names.end(), name) != names.end(); },
+                       minTime);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A small microbenchmark runner in the manner of Google Benchmark. A
+// benchmark loops `while (state.keepRunning())`; the runner raises the
+// iteration count until a run takes long enough to time, then reports the
+// time and the global heap allocations per iteration.
+class BenchmarkState
+{
+public:
+    explicit BenchmarkState(uint64_t iterations) : remaining_(iterations), iterations_(iterations) {}
+
+    // Starts the clock on the first call and stops it after the last iteration.
+    bool keepRunning()
+    {
+        if (!started_)
+        {
+            start();
+        }
+        if (remaining_ == 0)
+        {
+            stop();
+            return false;
+        }
+        --remaining_;
+        return true;
+    }
+
+    // Bytes handled per iteration, for a throughput column.
+    void setBytesPerIteration(uint64_t bytes) { bytesPerIteration_ = bytes; }
+
+    // Free text printed at the end of the benchmark's line.
+    void setLabel(std::string label) { label_ = std::move(label); }
+
+    [[nodiscard]] uint64_t iterations() const { return iterations_; }
+    [[nodiscard]] uint64_t bytesPerIteration() const { return bytesPerIteration_; }
+    [[nodiscard]] std::chrono::nanoseconds elapsed() const { return elapsed_; }
+    [[nodiscard]] uint64_t allocations() const { return allocations_; }
+    [[nodiscard]] const std::string &label() const { return label_; }
+
+private:
+    void start();
+    void stop();
+
+    uint64_t remaining_;
+    uint64_t iterations_;
+    uint64_t bytesPerIteration_ = 0;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point startedAt_;
+    uint64_t allocationsAtStart_ = 0;
+    std::chrono::nanoseconds elapsed_{0};
+    uint64_t allocations_ = 0;
+    std::string label_;
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState &);
+
+// Registers a benchmark at static initialization; see BB_BENCHMARK.
+bool registerBenchmark(const char *name, BenchmarkFunction function);
+
+#define BB_BENCHMARK_CONCAT_(a, b) a##b
+#define BB_BENCHMARK_CONCAT(a, b) BB_BENCHMARK_CONCAT_(a, b)
+#define BB_BENCHMARK(name, function) \
+    static const bool BB_BENCHMARK_CONCAT(benchmarkRegistered, __LINE__) = registerBenchmark(name, function)
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double nanosPerOp = 0;
+    double allocationsPerOp = 0;
+};
+
+// Runs the benchmarks whose name contains `filter`, printing one line each.
+std::vector<BenchmarkResult> runBenchmarks(std::string_view filter, std::chrono::milliseconds minTime);
+// Runs the benchmarks named exactly as in `names`, in registration order;
+// a name nobody registered gets no result.
+std::vector<BenchmarkResult> runBenchmarks(const std::vector<std::string_view> &names,
+                                           std::chrono::milliseconds minTime);
+
+// Global operator new calls so far, from any thread.
+uint64_t allocationCount();
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
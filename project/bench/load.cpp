@@ -0,0 +1,820 @@
+#include "load.hpp"
+
+#include "app.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    enum Kind
+    {
+        Ads,
+        Login,
+        Respond,
+        Create,
+        kKindCount,
+    };
+
+    constexpr const char *kKindNames[kKindCount] = {"ads", "login", "respond", "create"};
+    constexpr std::string_view kPassword = "bench-password";
+
+    // One keep-alive connection that reconnects when the server closes it.
+    class Client
+    {
+    public:
+        explicit Client(const sockaddr_in &address) : address_(address) {}
+        ~Client() { close(); }
+
+        Client(const Client &) = delete;
+        Client &operator=(const Client &) = delete;
+
+        // Sends `request` and waits for the whole answer. Returns the status
+        // code, or 0 if the server could not be reached.
+        int exchange(const std::string &request, std::string *body = nullptr)
+        {
+            // A reused connection may have been closed by the server meanwhile.
+            for (int attempt = 0; attempt < 2; ++attempt)
+            {
+                const bool reused = fd_ >= 0;
+                if (!reused && !connect())
+                {
+                    return 0;
+                }
+                if (sendAll(request))
+                {
+                    if (const int status = receive(body); status != 0)
+                    {
+                        return status;
+                    }
+                }
+                close();
+                if (!reused)
+                {
+                    break;
+                }
+            }
+            return 0;
+        }
+
+        // Response bytes read off the socket so far, headers included.
+        [[nodiscard]] uint64_t received() const { return received_; }
+
+    private:
+        bool connect()
+        {
+            fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd_ < 0)
+            {
+                return false;
+            }
+            if (::connect(fd_, reinterpret_cast<const sockaddr *>(&address_), sizeof(address_)) < 0)
+            {
+                close();
+                return false;
+            }
+            const int one = 1;
+            setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return true;
+        }
+
+        void close()
+        {
+            if (fd_ >= 0)
+            {
+                ::close(fd_);
+                fd_ = -1;
+            }
+            buffer_.clear();
+        }
+
+        bool sendAll(std::string_view data)
+        {
+            while (!data.empty())
+            {
+                const ssize_t sent = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+                if (sent <= 0)
+                {
+                    return false;
+                }
+                data.remove_prefix(static_cast<size_t>(sent));
+            }
+            return true;
+        }
+
+        bool fill()
+        {
+            char chunk[16 * 1024];
+            const ssize_t received = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+            {
+                return false;
+            }
+            buffer_.append(chunk, static_cast<size_t>(received));
+            received_ += static_cast<uint64_t>(received);
+            return true;
+        }
+
+        int receive(std::string *body)
+        {
+            size_t headerEnd;
+            while ((headerEnd = buffer_.find("\r\n\r\n")) == std::string::npos)
+            {
+                if (!fill())
+                {
+                    return 0;
+                }
+            }
+
+            const std::string_view head(buffer_.data(), headerEnd);
+            int status = 0;
+            const auto space = head.find(' ');
+            if (space == std::string_view::npos ||
+                std::from_chars(head.data() + space + 1, head.data() + head.size(), status).ec != std::errc())
+            {
+                return 0;
+            }
+            size_t contentLength = 0;
+            bool closeAfter = false;
+            for (size_t lineStart = head.find("\r\n"); lineStart != std::string_view::npos;)
+            {
+                lineStart += 2;
+                const auto lineEnd = head.find("\r\n", lineStart);
+                const auto line = head.substr(lineStart, lineEnd - lineStart);
+                const auto colon = line.find(':');
+                if (colon != std::string_view::npos)
+                {
+                    const auto name = line.substr(0, colon);
+                    const auto value = trim(line.substr(colon + 1));
+                    if (equalsIgnoreCase(name, "content-length"))
+                    {
+                        std::from_chars(value.data(), value.data() + value.size(), contentLength);
+                    }
+                    else if (equalsIgnoreCase(name, "connection") && equalsIgnoreCase(value, "close"))
+                    {
+                        closeAfter = true;
+                    }
+                }
+                lineStart = lineEnd;
+            }
+
+            const size_t total = headerEnd + 4 + contentLength;
+            while (buffer_.size() < total)
+            {
+                if (!fill())
+                {
+                    return 0;
+                }
+            }
+            if (body)
+            {
+                body->assign(buffer_, headerEnd + 4, contentLength);
+            }
+            buffer_.erase(0, total);
+            if (closeAfter)
+            {
+                close();
+            }
+            return status;
+        }
+
+        sockaddr_in address_;
+        int fd_ = -1;
+        std::string buffer_;
+        uint64_t received_ = 0;
+    };
+
+    struct ClientStats
+    {
+        std::vector<uint64_t> latencies[kKindCount];
+        uint64_t unsuccessful[kKindCount] = {};
+        uint64_t failed[kKindCount] = {};
+        uint64_t bytes[kKindCount] = {};
+    };
+
+    // Value of the first `"key":` in a JSON body; enough for our own responses.
+    std::string_view jsonField(std::string_view body, std::string_view key)
+    {
+        const std::string needle = "\"" + std::string(key) + "\":";
+        const auto at = body.find(needle);
+        if (at == std::string_view::npos)
+        {
+            return {};
+        }
+        auto value = body.substr(at + needle.size());
+        if (!value.empty() && value.front() == '"')
+        {
+            value.remove_prefix(1);
+            return value.substr(0, value.find('"'));
+        }
+        return value.substr(0, value.find_first_of(",}"));
+    }
+
+    std::vector<int> advertIds(std::string_view body)
+    {
+        std::vector<int> ids;
+        constexpr std::string_view needle = "{\"id\":";
+        for (auto at = body.find(needle); at != std::string_view::npos; at = body.find(needle, at + 1))
+        {
+            const char *begin = body.data() + at + needle.size();
+            int id = 0;
+            if (std::from_chars(begin, body.data() + body.size(), id).ec == std::errc())
+            {
+                ids.push_back(id);
+            }
+        }
+        return ids;
+    }
+
+    // Everything a client needs before the clock starts.
+    struct Session
+    {
+        std::string token;
+        std::string loginForm;
+        std::vector<int> adverts;
+    };
+
+    // Setup requests wait out 503s: many clients log in at once, and the
+    // server admits only so many password hashes at a time.
+    int exchangePatiently(Client &client, const std::string &request, std::string *body)
+    {
+        int status;
+        for (int attempt = 0; (status = client.exchange(request, body)) == 503 && attempt < 200; ++attempt)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return status;
+    }
+
+    std::optional<Session> prepare(Client &client, unsigned index)
+    {
+        Session session;
+        const std::string email =
+            "bench-" + std::to_string(::getpid()) + "-" + std::to_string(index) + "@example.com";
+        session.loginForm = "email=" + email + "&password=" + std::string(kPassword);
+
+        std::string body;
+        const std::string registerForm = "name=Bench+client+" + std::to_string(index) + "&" + session.loginForm;
+        if (exchangePatiently(client, buildRequest("POST", "/api/register", {}, registerForm), &body) != 200 ||
+            exchangePatiently(client, buildRequest("POST", "/api/login", {}, session.loginForm), &body) != 200)
+        {
+            std::fprintf(stderr, "client %u: cannot register and log in: %s\n", index, body.c_str());
+            return std::nullopt;
+        }
+        session.token = std::string(jsonField(body, "token"));
+
+        if (client.exchange(buildRequest("GET", "/api/ads", session.token), &body) != 200)
+        {
+            std::fprintf(stderr, "client %u: cannot list adverts\n", index);
+            return std::nullopt;
+        }
+        session.adverts = advertIds(body);
+        return session;
+    }
+
+    uint64_t percentile(const std::vector<uint64_t> &sorted, double q)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        // Nearest rank, as for the server's own quantiles.
+        const auto rank = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    void printRow(const char *name, std::vector<uint64_t> &latencies, uint64_t unsuccessful, uint64_t failed,
+                  uint64_t bytes, double seconds)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        const auto ms = [](uint64_t nanos)
+        { return static_cast<double>(nanos) / 1e6; };
+        std::printf("%-8s %10zu %9llu %7llu %11.1f %9.3f %9.3f %9.3f %9.3f %9.0f\n", name, latencies.size(),
+                    static_cast<unsigned long long>(unsuccessful), static_cast<unsigned long long>(failed),
+                    static_cast<double>(latencies.size()) / seconds, ms(percentile(latencies, 0.5)),
+                    ms(percentile(latencies, 0.99)), ms(percentile(latencies, 0.999)),
+                    ms(latencies.empty() ? 0 : latencies.back()),
+                    latencies.empty() ? 0.0 : static_cast<double>(bytes) / static_cast<double>(latencies.size()));
+    }
+
+    bool drive(const sockaddr_in &address, const LoadOptions &options)
+    {
+        const unsigned connections = std::max(1u, options.connections);
+        const unsigned weights[kKindCount] = {options.adsWeight, options.loginWeight, options.respondWeight,
+                                              options.createWeight};
+        if (std::all_of(std::begin(weights), std::end(weights), [](unsigned weight)
+                        { return weight == 0; }))
+        {
+            std::fprintf(stderr, "the request mix is empty\n");
+            return false;
+        }
+
+        std::vector<ClientStats> stats(connections);
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> setupFailed{false};
+        std::atomic<bool> go{false};
+        Clock::time_point start;
+        Clock::time_point deadline;
+        // Open loop: every client sends on its own fixed schedule.
+        const auto interval = options.rate > 0
+                                  ? std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(connections / options.rate))
+                                  : Clock::duration::zero();
+
+        std::vector<std::thread> threads;
+        for (unsigned index = 0; index < connections; ++index)
+        {
+            threads.emplace_back([&, index]()
+                                 {
+                Client client(address);
+                const auto session = prepare(client, index);
+                if (!session)
+                {
+                    setupFailed = true;
+                }
+                ready.fetch_add(1);
+                while (!go.load())
+                {
+                    if (setupFailed.load())
+                    {
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                auto &mine = stats[index];
+                std::mt19937 random(index + 1);
+                std::discrete_distribution<int> pickKind(std::begin(weights), std::end(weights));
+                const auto &encoding = options.acceptEncoding;
+                const std::string adsRequest = buildRequest("GET", "/api/ads", session->token, {}, encoding);
+                const std::string loginRequest =
+                    buildRequest("POST", "/api/login", {}, session->loginForm, encoding);
+                std::string request;
+                // Spread the clients' schedules over one interval.
+                auto due = start + interval * index / connections;
+                for (uint64_t sent = 0;; ++sent)
+                {
+                    if (interval != Clock::duration::zero())
+                    {
+                        std::this_thread::sleep_until(due);
+                    }
+                    const auto began = interval != Clock::duration::zero() ? due : Clock::now();
+                    if (began >= deadline)
+                    {
+                        break;
+                    }
+                    due += interval;
+
+                    const int kind = pickKind(random);
+                    const std::string *toSend = &request;
+                    switch (kind)
+                    {
+                    case Ads:
+                        toSend = &adsRequest;
+                        break;
+                    case Login:
+                        toSend = &loginRequest;
+                        break;
+                    case Respond:
+                    {
+                        const int advert = session->adverts.empty()
+                                               ? 1
+                                               : session->adverts[random() % session->adverts.size()];
+                        request = buildRequest("POST", "/api/ads/" + std::to_string(advert) + "/respond",
+                                               session->token, {}, encoding);
+                        break;
+                    }
+                    default:
+                        request = buildRequest("POST", "/api/ads", session->token,
+                                               "title=Bench+advert+" + std::to_string(index) + "-" +
+                                                   std::to_string(sent) +
+                                                   "&description=Posted+by+the+load+generator&price=10",
+                                               encoding);
+                        break;
+                    }
+
+                    const uint64_t receivedBefore = client.received();
+                    const int status = client.exchange(*toSend);
+                    mine.bytes[kind] += client.received() - receivedBefore;
+                    mine.latencies[kind].push_back(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - began).count()));
+                    if (status == 0)
+                    {
+                        ++mine.failed[kind];
+                    }
+                    else if (status < 200 || status >= 300)
+                    {
+                        ++mine.unsuccessful[kind];
+                    }
+                } });
+        }
+
+        while (ready.load() < connections)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        start = Clock::now() + std::chrono::milliseconds(50);
+        deadline = start + options.duration;
+        if (!setupFailed.load())
+        {
+            go = true;
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        if (setupFailed.load())
+        {
+            return false;
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::printf("%u connections, %s, %.1f s\n", connections,
+                    options.rate > 0 ? ("open loop at " + std::to_string(static_cast<long long>(options.rate)) + " req/s").c_str()
+                                     : "closed loop",
+                    seconds);
+        std::printf("%-8s %10s %9s %7s %11s %9s %9s %9s %9s %9s\n", "kind", "requests", "non-2xx", "failed",
+                    "req/s", "p50 ms", "p99 ms", "p99.9 ms", "max ms", "B/resp");
+        std::vector<uint64_t> all;
+        uint64_t allUnsuccessful = 0;
+        uint64_t allFailed = 0;
+        uint64_t allBytes = 0;
+        for (int kind = 0; kind < kKindCount; ++kind)
+        {
+            std::vector<uint64_t> latencies;
+            uint64_t unsuccessful = 0;
+            uint64_t failed = 0;
+            uint64_t bytes = 0;
+            for (const auto &client : stats)
+            {
+                bytes += client.bytes[kind];
+                latencies.insert(latencies.end(), client.latencies[kind].begin(), client.latencies[kind].end());
+                unsuccessful += client.unsuccessful[kind];
+                failed += client.failed[kind];
+            }
+            if (latencies.empty())
+            {
+                continue;
+            }
+            all.insert(all.end(), latencies.begin(), latencies.end());
+            allUnsuccessful += unsuccessful;
+            allFailed += failed;
+            allBytes += bytes;
+            printRow(kKindNames[kind], latencies, unsuccessful, failed, bytes, seconds);
+        }
+        printRow("all", all, allUnsuccessful, allFailed, allBytes, seconds);
+        return true;
+    }
+
+    std::optional<sockaddr_in> resolve(const std::string &host, uint16_t port)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *result = nullptr;
+        if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+        {
+            std::fprintf(stderr, "cannot resolve %s\n", host.c_str());
+            return std::nullopt;
+        }
+        sockaddr_in address = *reinterpret_cast<const sockaddr_in *>(result->ai_addr);
+        freeaddrinfo(result);
+        address.sin_port = htons(port);
+        return address;
+    }
+
+    bool canConnect(const sockaddr_in &address)
+    {
+        const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool connected =
+            fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return connected;
+    }
+
+    AppOptions inProcessAppOptions(unsigned workerThreads, int compressionLevel)
+    {
+        AppOptions appOptions;
+        appOptions.hashThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        appOptions.maxPendingHashes = std::max(1u, std::max(1u, workerThreads) / 2);
+        appOptions.compressionLevel = compressionLevel;
+        // Every client comes from 127.0.0.1; the point is to load the server, not its limiter.
+        appOptions.apiRatePerMinute = 0;
+        appOptions.authRatePerMinute = 0;
+        appOptions.writeRatePerMinute = 0;
+        return appOptions;
+    }
+
+    // Serves `app` on 127.0.0.1:`port` from this process while `run` goes.
+    bool serveInProcess(BulletinBoardApp &app, uint16_t port, unsigned ioThreads, unsigned workerThreads,
+                        const std::function<bool(const sockaddr_in &)> &run)
+    {
+        const auto address = resolve("127.0.0.1", port);
+        if (!address)
+        {
+            return false;
+        }
+        if (canConnect(*address))
+        {
+            std::fprintf(stderr, "port %u is taken; pass --port or --connect\n", port);
+            return false;
+        }
+
+        ServerOptions serverOptions;
+        serverOptions.port = port;
+        serverOptions.ioThreads = std::max(1u, ioThreads);
+        serverOptions.workerThreads = std::max(1u, workerThreads);
+        // Clients keep their connection for the whole run.
+        serverOptions.maxRequestsPerConnection = std::numeric_limits<unsigned>::max();
+        HttpServer server(serverOptions, [&app](const HttpRequest &request, HttpResponse &response)
+                          { app.routeRequest(request, response); });
+        std::atomic<bool> serverFailed{false};
+        std::thread serverThread([&]()
+                                 {
+            if (!server.run())
+            {
+                serverFailed = true;
+            } });
+
+        bool listening = false;
+        for (int attempt = 0; attempt < 250 && !serverFailed.load() && !listening; ++attempt)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            listening = canConnect(*address);
+        }
+        const bool ok = listening && run(*address);
+        server.stop();
+        serverThread.join();
+        return ok;
+    }
+
+    // A fresh directory holding only bench.bin: `size` random bytes, so that
+    // no compressed variant is kept and it goes out as is.
+    std::filesystem::path writeStaticRoot(size_t size)
+    {
+        char pattern[] = "/tmp/bb_bench-XXXXXX";
+        if (!::mkdtemp(pattern))
+        {
+            std::perror("mkdtemp");
+            return {};
+        }
+        const std::filesystem::path root(pattern);
+        std::string content(size, '\0');
+        std::mt19937_64 random(size);
+        for (auto &ch : content)
+        {
+            ch = static_cast<char>(random());
+        }
+        std::ofstream out(root / "bench.bin", std::ios::binary);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        out.close();
+        if (!out)
+        {
+            std::fprintf(stderr, "cannot write %s\n", (root / "bench.bin").c_str());
+            std::error_code ec;
+            std::filesystem::remove_all(root, ec);
+            return {};
+        }
+        return root;
+    }
+
+    // Posts `count` adverts from one seller so /api/ads has that many more entries.
+    bool postAdverts(const sockaddr_in &address, unsigned count)
+    {
+        if (count == 0)
+        {
+            return true;
+        }
+        Client client(address);
+        const auto seller = prepare(client, std::numeric_limits<unsigned>::max());
+        if (!seller)
+        {
+            return false;
+        }
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const std::string form = "title=Bench+advert+" + std::to_string(i) +
+                                     "&description=Posted+to+make+the+list+long%2C+with+a+few+words+more+than+a+title+"
+                                     "and+a+%22quoted%22+one&price=" +
+                                     std::to_string(100 + i % 1000);
+            if (client.exchange(buildRequest("POST", "/api/ads", seller->token, form)) != 200)
+            {
+                std::fprintf(stderr, "cannot post advert %u\n", i);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool driveThroughput(const sockaddr_in &address, const ThroughputOptions &options)
+    {
+        const unsigned connections = std::max(1u, options.connections);
+        struct Stats
+        {
+            std::vector<uint64_t> latencies;
+            uint64_t unsuccessful = 0;
+            uint64_t failed = 0;
+            uint64_t bytes = 0;
+        };
+        std::vector<Stats> stats(connections);
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> setupFailed{false};
+        std::atomic<bool> go{false};
+        Clock::time_point deadline;
+
+        std::vector<std::thread> threads;
+        for (unsigned index = 0; index < connections; ++index)
+        {
+            threads.emplace_back([&, index]()
+                                 {
+                Client client(address);
+                std::string token;
+                if (options.signedIn)
+                {
+                    if (const auto session = prepare(client, index))
+                    {
+                        token = session->token;
+                    }
+                    else
+                    {
+                        setupFailed = true;
+                    }
+                }
+                const std::string request = buildRequest("GET", options.target, token, {}, options.acceptEncoding);
+                ready.fetch_add(1);
+                while (!go.load())
+                {
+                    if (setupFailed.load())
+                    {
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                auto &mine = stats[index];
+                for (auto began = Clock::now(); began < deadline; began = Clock::now())
+                {
+                    const uint64_t receivedBefore = client.received();
+                    const int status = client.exchange(request);
+                    mine.bytes += client.received() - receivedBefore;
+                    mine.latencies.push_back(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - began).count()));
+                    if (status == 0)
+                    {
+                        ++mine.failed;
+                    }
+                    else if (status < 200 || status >= 300)
+                    {
+                        ++mine.unsuccessful;
+                    }
+                } });
+        }
+
+        while (ready.load() < connections)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        const auto start = Clock::now();
+        deadline = start + options.duration;
+        if (!setupFailed.load())
+        {
+            go = true;
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        if (setupFailed.load())
+        {
+            return false;
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<uint64_t> all;
+        uint64_t unsuccessful = 0;
+        uint64_t failed = 0;
+        uint64_t bytes = 0;
+        for (const auto &client : stats)
+        {
+            all.insert(all.end(), client.latencies.begin(), client.latencies.end());
+            unsuccessful += client.unsuccessful;
+            failed += client.failed;
+            bytes += client.bytes;
+        }
+        std::printf("%u connections, GET %s%s, closed loop, %.1f s\n", connections, options.target.c_str(),
+                    options.signedIn ? " signed in" : "", seconds);
+        std::printf("%-8s %10s %9s %7s %11s %9s %9s %9s %9s %9s\n", "kind", "requests", "non-2xx", "failed",
+                    "req/s", "p50 ms", "p99 ms", "p99.9 ms", "max ms", "B/resp");
+        printRow("get", all, unsuccessful, failed, bytes, seconds);
+        std::printf("%.1f MB/s received\n", static_cast<double>(bytes) / seconds / 1e6);
+        return true;
+    }
+}
+
+std::string buildRequest(std::string_view method, std::string_view target, std::string_view token,
+                         std::string_view form, std::string_view acceptEncoding)
+{
+    std::string request;
+    request.append(method).append(" ").append(target).append(" HTTP/1.1\r\nHost: localhost\r\n");
+    if (!acceptEncoding.empty())
+    {
+        request.append("Accept-Encoding: ").append(acceptEncoding).append("\r\n");
+    }
+    if (!token.empty())
+    {
+        request.append("Authorization: Bearer ").append(token).append("\r\n");
+    }
+    if (!form.empty() || method != "GET")
+    {
+        request.append("Content-Type: application/x-www-form-urlencoded\r\nContent-Length: ")
+            .append(std::to_string(form.size()))
+            .append("\r\n");
+    }
+    request.append("\r\n").append(form);
+    return request;
+}
+
+bool runLoad(const LoadOptions &options)
+{
+    if (!options.host.empty())
+    {
+        const auto address = resolve(options.host, options.port);
+        return address && drive(*address, options);
+    }
+
+    AppOptions appOptions = inProcessAppOptions(options.workerThreads, options.compressionLevel);
+    appOptions.hashIterations = std::max<uint32_t>(1, options.hashIterations);
+    BulletinBoardApp app(appOptions);
+    app.seedDemoData();
+    return serveInProcess(app, options.port, options.ioThreads, options.workerThreads,
+                          [&](const sockaddr_in &address)
+                          { return drive(address, options); });
+}
+
+bool runThroughput(const ThroughputOptions &options)
+{
+    ThroughputOptions effective = options;
+    if (effective.target.empty())
+    {
+        effective.target = options.staticSize > 0 ? "/bench.bin" : "/api/ads";
+    }
+    if (!options.host.empty())
+    {
+        const auto address = resolve(options.host, options.port);
+        return address && driveThroughput(*address, effective);
+    }
+
+    AppOptions appOptions = inProcessAppOptions(options.workerThreads, options.compressionLevel);
+    // Clients register at most once; keep that cheap.
+    appOptions.hashIterations = 1000;
+    std::filesystem::path staticRoot;
+    if (options.staticSize > 0)
+    {
+        staticRoot = writeStaticRoot(options.staticSize);
+        if (staticRoot.empty())
+        {
+            return false;
+        }
+        appOptions.staticRoot = staticRoot;
+    }
+
+    bool ok;
+    {
+        BulletinBoardApp app(appOptions);
+        app.seedDemoData();
+        ok = serveInProcess(app, options.port, options.ioThreads, options.workerThreads,
+                            [&](const sockaddr_in &address)
+                            { return postAdverts(address, options.adverts) && driveThroughput(address, effective); });
+    }
+    if (!staticRoot.empty())
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(staticRoot, ec);
+    }
+    return ok;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+struct LoadOptions
+{
+    // Empty: start a server with demo data inside bb_bench on `port`.
+    std::string host;
+    uint16_t port = 8090;
+    unsigned connections = 16;
+    std::chrono::seconds duration{10};
+    // Requests per second over all connections; 0 sends the next request as
+    // soon as the previous answer arrives (closed loop).
+    double rate = 0;
+    // Relative weights of the request kinds.
+    unsigned adsWeight = 70;
+    unsigned loginWeight = 10;
+    unsigned respondWeight = 10;
+    unsigned createWeight = 10;
+    // Sent as Accept-Encoding with every measured request when not empty.
+    std::string acceptEncoding;
+    // For the in-process server.
+    unsigned ioThreads = 1;
+    unsigned workerThreads = 4;
+    uint32_t hashIterations = 100000;
+    int compressionLevel = 1;
+};
+
+// Drives the server with `options.connections` keep-alive clients and prints
+// throughput and latency percentiles per request kind. In open-loop mode
+// latency runs from when a request was due, not when it was sent, so a
+// stalled server is not hidden by clients that waited for it.
+bool runLoad(const LoadOptions &options);
+
+struct ThroughputOptions
+{
+    // Empty: start a server inside bb_bench on `port`.
+    std::string host;
+    uint16_t port = 8090;
+    // Requested over and over; empty for /bench.bin when staticSize is set
+    // and /api/ads otherwise.
+    std::string target;
+    unsigned connections = 4;
+    std::chrono::seconds duration{10};
+    // Each client registers and sends its token, so /api/ads is rendered for
+    // it instead of coming from the anonymous cache.
+    bool signedIn = false;
+    std::string acceptEncoding;
+    // For the in-process server: adverts posted on top of the demo data, and
+    // the size of an incompressible /bench.bin served instead of public/ (0: none).
+    unsigned adverts = 10000;
+    size_t staticSize = 0;
+    unsigned ioThreads = 1;
+    unsigned workerThreads = 4;
+    int compressionLevel = 1;
+};
+
+// Fetches one target with `options.connections` keep-alive clients in a
+// closed loop and prints requests per second, latency percentiles and the
+// response bytes per second off the wire, for large bodies where the cost
+// is in moving bytes rather than in handling the request.
+bool runThroughput(const ThroughputOptions &options);
+
+// HTTP/1.1 request text with an optional bearer token, form body and Accept-Encoding.
+std::string buildRequest(std::string_view method, std::string_view target, std::string_view token = {},
+                         std::string_view form = {}, std::string_view acceptEncoding = {});
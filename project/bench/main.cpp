@@ -0,0 +1,211 @@
+#include "checks.hpp"
+#include "harness.hpp"
+#include "load.hpp"
+
+#include "flags.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    int usage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " micro [--filter TEXT] [--min-time MS]\n"
+                  << "       " << program << " check [--max-allocs N] [--min-time MS]\n"
+                  << "       " << program
+                  << " load [--connect HOST] [--port N] [--connections N] [--duration SEC] [--rate RPS] "
+                  << "[--mix ADS,LOGIN,RESPOND,CREATE] [--accept-encoding CODINGS] [--io-threads N] [--workers N] "
+                  << "[--hash-iterations N] [--compression-level 0-9]\n"
+                  << "       " << program
+                  << " throughput [--connect HOST] [--port N] [--connections N] [--duration SEC] [--path TARGET] "
+                  << "[--signed-in] [--accept-encoding CODINGS] [--adverts N] [--static-size BYTES] "
+                  << "[--io-threads N] [--workers N] [--compression-level 0-9]"
+                  << std::endl;
+        return 1;
+    }
+
+    // Work that runs on the connection arena and has to stay off the global
+    // heap once warm; `check` fails when one of them does not.
+    const std::vector<std::string_view> kSteadyStateBenchmarks = {
+        "parseRequest/get", "parseRequest/post_form", "parseParams/arena", "urlDecode/form",
+        "route/id_capture", "route/405", "exchange/session",
+    };
+
+    int checkAllocations(double maxAllocations, std::chrono::milliseconds minTime)
+    {
+        bool ok = runBehaviourChecks();
+        const auto results = runBenchmarks(kSteadyStateBenchmarks, minTime);
+        if (results.size() != kSteadyStateBenchmarks.size())
+        {
+            ok = false;
+            std::cerr << "check: some steady-state benchmarks are not registered" << std::endl;
+        }
+        for (const auto &result : results)
+        {
+            if (result.allocationsPerOp > maxAllocations)
+            {
+                std::cerr << "check: " << result.name << " makes " << result.allocationsPerOp
+                          << " allocations per operation, more than " << maxAllocations << std::endl;
+                ok = false;
+            }
+        }
+        return ok ? 0 : 1;
+    }
+
+    // "70,10,10,10" into the four weights.
+    bool parseMix(std::string_view text, LoadOptions &options)
+    {
+        unsigned *weights[] = {&options.adsWeight, &options.loginWeight, &options.respondWeight,
+                               &options.createWeight};
+        size_t position = 0;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            const auto comma = text.find(',', position);
+            if ((i < 3) == (comma == std::string_view::npos) ||
+                !parseFlagValue(text.substr(position, comma - position), *weights[i]))
+            {
+                return false;
+            }
+            position = comma + 1;
+        }
+        return true;
+    }
+
+    int invalidValue(const char *program, const char *flag, const char *value)
+    {
+        std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+        return usage(program);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        return usage(argv[0]);
+    }
+
+    if (std::strcmp(argv[1], "micro") == 0)
+    {
+        std::string filter;
+        std::chrono::milliseconds minTime(500);
+        for (int i = 2; i < argc; ++i)
+        {
+            const bool hasValue = i + 1 < argc;
+            bool valid = true;
+            if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+                filter = argv[++i];
+            else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], minTime);
+            else
+                return usage(argv[0]);
+            if (!valid)
+                return invalidValue(argv[0], argv[i - 1], argv[i]);
+        }
+        runBenchmarks(filter, minTime);
+        return 0;
+    }
+
+    if (std::strcmp(argv[1], "check") == 0)
+    {
+        double maxAllocations = 0.05;
+        std::chrono::milliseconds minTime(200);
+        for (int i = 2; i < argc; ++i)
+        {
+            const bool hasValue = i + 1 < argc;
+            bool valid = true;
+            if (std::strcmp(argv[i], "--max-allocs") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], maxAllocations);
+            else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], minTime);
+            else
+                return usage(argv[0]);
+            if (!valid)
+                return invalidValue(argv[0], argv[i - 1], argv[i]);
+        }
+        return checkAllocations(maxAllocations, minTime);
+    }
+
+    if (std::strcmp(argv[1], "load") == 0)
+    {
+        LoadOptions options;
+        for (int i = 2; i < argc; ++i)
+        {
+            const bool hasValue = i + 1 < argc;
+            bool valid = true;
+            if (std::strcmp(argv[i], "--connect") == 0 && hasValue)
+                options.host = argv[++i];
+            else if (std::strcmp(argv[i], "--port") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.port);
+            else if (std::strcmp(argv[i], "--connections") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.connections);
+            else if (std::strcmp(argv[i], "--duration") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.duration);
+            else if (std::strcmp(argv[i], "--rate") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.rate);
+            else if (std::strcmp(argv[i], "--mix") == 0 && hasValue)
+                valid = parseMix(argv[++i], options);
+            else if (std::strcmp(argv[i], "--accept-encoding") == 0 && hasValue)
+                options.acceptEncoding = argv[++i];
+            else if (std::strcmp(argv[i], "--io-threads") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.ioThreads);
+            else if (std::strcmp(argv[i], "--workers") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.workerThreads);
+            else if (std::strcmp(argv[i], "--hash-iterations") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.hashIterations);
+            else if (std::strcmp(argv[i], "--compression-level") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.compressionLevel, 9);
+            else
+                return usage(argv[0]);
+            if (!valid)
+                return invalidValue(argv[0], argv[i - 1], argv[i]);
+        }
+        return runLoad(options) ? 0 : 1;
+    }
+
+    if (std::strcmp(argv[1], "throughput") == 0)
+    {
+        ThroughputOptions options;
+        for (int i = 2; i < argc; ++i)
+        {
+            const bool hasValue = i + 1 < argc;
+            bool valid = true;
+            if (std::strcmp(argv[i], "--connect") == 0 && hasValue)
+                options.host = argv[++i];
+            else if (std::strcmp(argv[i], "--port") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.port);
+            else if (std::strcmp(argv[i], "--connections") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.connections);
+            else if (std::strcmp(argv[i], "--duration") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.duration);
+            else if (std::strcmp(argv[i], "--path") == 0 && hasValue)
+                options.target = argv[++i];
+            else if (std::strcmp(argv[i], "--signed-in") == 0)
+                options.signedIn = true;
+            else if (std::strcmp(argv[i], "--accept-encoding") == 0 && hasValue)
+                options.acceptEncoding = argv[++i];
+            else if (std::strcmp(argv[i], "--adverts") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.adverts);
+            else if (std::strcmp(argv[i], "--static-size") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.staticSize);
+            else if (std::strcmp(argv[i], "--io-threads") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.ioThreads);
+            else if (std::strcmp(argv[i], "--workers") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.workerThreads);
+            else if (std::strcmp(argv[i], "--compression-level") == 0 && hasValue)
+                valid = parseFlagValue(argv[++i], options.compressionLevel, 9);
+            else
+                return usage(argv[0]);
+            if (!valid)
+                return invalidValue(argv[0], argv[i - 1], argv[i]);
+        }
+        return runThroughput(options) ? 0 : 1;
+    }
+
+    return usage(argv[0]);
+}
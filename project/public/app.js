@@ -1,6 +1,13 @@
 const state = {
   token: localStorage.getItem('bb_token') || '',
   user: null,
+  // Списки в том виде, в каком они показаны; события с сервера правят их на месте
+  ads: [],
+  // Номер последнего изменения, учтённого в state.ads; null — нужен полный список
+  adsSequence: null,
+  myAds: [],
+  myResponses: [],
+  events: null,
 };
 
 const els = {
@@ -8,6 +15,7 @@ const els = {
   loginForm: document.getElementById('loginForm'),
   adForm: document.getElementById('adForm'),
   refreshAds: document.getElementById('refreshAds'),
+  searchAds: document.getElementById('searchAds'),
   adsList: document.getElementById('adsList'),
   myAdsList: document.getElementById('myAdsList'),
   myResponsesList: document.getElementById('myResponsesList'),
@@ -99,14 +107,112 @@ async function refreshSession() {
 }
 
 async function loadAds() {
+  const query = els.searchAds.value.trim();
   try {
-    const data = await fetchJson('/api/ads');
-    renderAds(els.adsList, data.ads || [], false);
+    if (query) {
+      const data = await fetchJson(`/api/ads/search?limit=100&q=${encodeURIComponent(query)}`);
+      state.ads = data.ads || [];
+      state.adsSequence = null;
+    } else {
+      // Загружаем только то, что изменилось; сервер сам скажет, если нужен весь список
+      const since = state.adsSequence === null ? '' : `?since=${state.adsSequence}`;
+      const data = await fetchJson(`/api/ads/changes${since}`);
+      state.ads = data.resync ? data.ads || [] : applyAdChanges(state.ads, data);
+      state.adsSequence = data.sequence;
+    }
+    renderAds(els.adsList, state.ads, false);
   } catch (error) {
     showMessage(error.message, true);
   }
 }
 
+// Изменения можно применять повторно: часть из них уже могла прийти событием
+function applyAdChanges(ads, { added = [], updated = [], removed = [] }) {
+  const gone = new Set(removed);
+  const fresh = new Map([...added, ...updated].map((ad) => [ad.id, ad]));
+  const result = ads.filter((ad) => !gone.has(ad.id)).map((ad) => fresh.get(ad.id) || ad);
+  const present = new Set(result.map((ad) => ad.id));
+  fresh.forEach((ad, id) => {
+    if (!present.has(id)) {
+      result.push(ad);
+    }
+  });
+  return result;
+}
+
+// Живые обновления: сервер присылает изменения через /api/events, поэтому
+// списки правятся на месте, а не перезагружаются после каждого действия.
+function connectEvents() {
+  // Поля объявлений зависят от того, кто смотрит: после входа или выхода список перечитывается целиком
+  state.adsSequence = null;
+  if (state.events) {
+    state.events.close();
+    state.events = null;
+  }
+  if (typeof EventSource === 'undefined') {
+    loadAds();
+    return;
+  }
+  // EventSource не умеет передавать заголовки, поэтому токен идёт в запросе
+  const query = state.token ? `?token=${encodeURIComponent(state.token)}` : '';
+  const events = new EventSource(`/api/events${query}`);
+  // Пока соединения не было, изменения могли пройти мимо: перечитываем списки
+  events.addEventListener('open', () => {
+    loadAds();
+    loadMyAds();
+    loadMyResponses();
+  });
+  events.addEventListener('ad-created', (event) => onAdCreated(JSON.parse(event.data)));
+  events.addEventListener('ad-deleted', (event) => onAdDeleted(JSON.parse(event.data)));
+  events.addEventListener('ad-responses', (event) => onAdResponses(JSON.parse(event.data)));
+  state.events = events;
+}
+
+function liveUpdates() {
+  return Boolean(state.events) && state.events.readyState === EventSource.OPEN;
+}
+
+function onAdCreated(ad) {
+  const mine = Boolean(state.user) && ad.ownerId === state.user.id;
+  const entry = mine ? { ...ad, mine, responsesCount: 0 } : ad;
+  // Результаты поиска не трогаем: новое объявление может им не подходить
+  if (!els.searchAds.value.trim()) {
+    state.ads.push(entry);
+    renderAds(els.adsList, state.ads, false);
+  }
+  if (mine && els.myAdsList) {
+    state.myAds.push(entry);
+    renderAds(els.myAdsList, state.myAds, true);
+  }
+}
+
+function onAdDeleted({ id }) {
+  const without = (ads) => ads.filter((ad) => ad.id !== id);
+  if (state.ads.some((ad) => ad.id === id)) {
+    state.ads = without(state.ads);
+    renderAds(els.adsList, state.ads, false);
+  }
+  if (els.myAdsList && state.myAds.some((ad) => ad.id === id)) {
+    state.myAds = without(state.myAds);
+    renderAds(els.myAdsList, state.myAds, true);
+  }
+  if (els.myResponsesList && state.myResponses.some((ad) => ad.id === id)) {
+    state.myResponses = without(state.myResponses);
+    renderAds(els.myResponsesList, state.myResponses, false);
+  }
+}
+
+// Приходит только автору объявления
+function onAdResponses({ adId, responsesCount }) {
+  const update = (ads) => ads.map((ad) => (ad.id === adId ? { ...ad, responsesCount } : ad));
+  state.ads = update(state.ads);
+  renderAds(els.adsList, state.ads, false);
+  if (els.myAdsList) {
+    state.myAds = update(state.myAds);
+    renderAds(els.myAdsList, state.myAds, true);
+  }
+}
+
 function renderAds(listElement, ads, withActions = false) {
   if (!ads.length) {
     listElement.innerHTML = '<p class="muted">Пока нет объявлений</p>';
@@ -231,8 +337,10 @@ async function deleteAd(id) {
     });
     await handleResponse(response);
     showMessage('Объявление удалено');
-    loadAds();
-    loadMyAds();
+    if (!liveUpdates()) {
+      loadAds();
+      loadMyAds();
+    }
   } catch (error) {
     showMessage(error.message, true);
   }
@@ -258,9 +366,8 @@ async function respondToAd(id, button) {
     button.textContent = '✓ Вы откликнулись';
     button.classList.add('responded');
 
-    // Обновляем список объявлений и откликов
-    loadAds();
-    loadMyAds();
+    // Отмечаем отклик на месте; счётчик автору придёт событием
+    state.ads = state.ads.map((ad) => (ad.id === id ? { ...ad, hasResponded: true } : ad));
     loadMyResponses();
   } catch (error) {
     showMessage(error.message, true);
@@ -395,6 +502,7 @@ els.loginForm.addEventListener('submit', async (event) => {
     event.target.reset();
     closeModal();
     await refreshSession();
+    connectEvents();
   } catch (error) {
     showMessage(error.message, true);
   }
@@ -411,6 +519,7 @@ els.profileLogout.addEventListener('click', async () => {
     localStorage.removeItem('bb_token');
     updateMyAdsUI();
     refreshSession();
+    connectEvents();
   }
 });
 
@@ -425,8 +534,10 @@ els.adForm.addEventListener('submit', async (event) => {
     await postForm('/api/ads', event.target);
     showMessage('Объявление опубликовано');
     event.target.reset();
-    loadAds();
-    loadMyAds();
+    if (!liveUpdates()) {
+      loadAds();
+      loadMyAds();
+    }
   } catch (error) {
     showMessage(error.message, true);
   }
@@ -434,6 +545,12 @@ els.adForm.addEventListener('submit', async (event) => {
 
 els.refreshAds.addEventListener('click', loadAds);
 
+let searchTimer = null;
+els.searchAds.addEventListener('input', () => {
+  clearTimeout(searchTimer);
+  searchTimer = setTimeout(loadAds, 250);
+});
+
 function updateMyAdsUI() {
   if (state.user) {
     els.authActions.classList.add('hidden');
@@ -465,9 +582,9 @@ function updateMyAdsUI() {
 async function loadMyAds() {
   if (!state.token || !els.myAdsList) return;
   try {
-    const data = await fetchJson('/api/ads');
-    const myAds = (data.ads || []).filter((ad) => ad.mine);
-    renderAds(els.myAdsList, myAds, true);
+    const data = await fetchJson('/api/ads?owner=me');
+    state.myAds = data.ads || [];
+    renderAds(els.myAdsList, state.myAds, true);
   } catch (error) {
     showMessage(error.message, true);
   }
@@ -477,7 +594,8 @@ async function loadMyResponses() {
   if (!state.token || !els.myResponsesList) return;
   try {
     const data = await fetchJson('/api/ads/my-responses');
-    renderAds(els.myResponsesList, data.ads || [], false);
+    state.myResponses = data.ads || [];
+    renderAds(els.myResponsesList, state.myResponses, false);
   } catch (error) {
     showMessage(error.message, true);
   }
@@ -486,5 +604,5 @@ async function loadMyResponses() {
 setActiveTab('login');
 updateMyAdsUI();
 refreshSession();
-loadAds();
+connectEvents();
 
@@ -0,0 +1,1586 @@
+#include "app.hpp"
+
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace
+{
+    constexpr size_t kMaxPageSize = 100;
+    constexpr size_t kDefaultSearchLimit = 20;
+    // Rough size of one serialized advert, used to pre-size response buffers.
+    constexpr size_t kAdJsonSizeHint = 256;
+    // Changes kept for /api/ads/changes; clients further behind resync.
+    constexpr size_t kChangeLogCapacity = 4096;
+    // Clients tracked by the rate limiter at most, over all limits.
+    constexpr size_t kRateLimitBuckets = 65536;
+
+    // Indexes into rateLimiter_. Every routed request counts against
+    // kApiLimit; a route names at most one more in its table entry.
+    enum RateLimitId : uint8_t
+    {
+        kApiLimit,
+        kAuthLimit,
+        kWriteLimit,
+    };
+
+    // Up to twenty seconds' worth of requests may come at once.
+    RateLimiter::Limit perMinute(unsigned requests)
+    {
+        return {requests / 60.0, std::max(5.0, requests / 3.0)};
+    }
+
+    template <typename T>
+    std::optional<T> parseNumber(std::string_view text)
+    {
+        T value{};
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size())
+        {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Prices above this are refused; it keeps every stored price printable
+    // with JsonWriter::fixed and far inside the range doubles hold exactly
+    // to the cent.
+    constexpr double kMaxPrice = 1e12;
+
+    // Sort keys a cursor may carry: creation times and prices are both well
+    // inside this, and anything in it converts to std::time_t without loss.
+    constexpr double kMaxCursorKey = 9007199254740992.0; // 2^53
+
+    // A NaN would break the ordering of the price index.
+    bool validPrice(double price)
+    {
+        return std::isfinite(price) && price >= 0 && price <= kMaxPrice;
+    }
+
+    // A price or price bound: one number and nothing else. std::stod would
+    // also take "nan", "inf" and "12abc".
+    std::optional<double> parsePrice(std::string_view text)
+    {
+        const auto value = parseNumber<double>(text);
+        if (!value || !validPrice(*value))
+        {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Cursors are "<sort key>:<advert id>" of the last advert on a page.
+    std::string encodeCursor(double key, int id)
+    {
+        char buffer[64];
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), key).ptr;
+        *end++ = ':';
+        end = std::to_chars(end, buffer + sizeof(buffer), id).ptr;
+        return std::string(buffer, end);
+    }
+
+    std::optional<std::pair<double, int>> decodeCursor(std::string_view cursor)
+    {
+        const auto colon = cursor.find(':');
+        if (colon == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        const auto key = parseNumber<double>(cursor.substr(0, colon));
+        const auto id = parseNumber<int>(cursor.substr(colon + 1));
+        // The store casts the key of a date-sorted page to std::time_t, which
+        // is undefined for NaN, infinities and values out of its range.
+        if (!key || !id || !std::isfinite(*key) || *key < 0 || *key > kMaxCursorKey)
+        {
+            return std::nullopt;
+        }
+        return std::make_pair(*key, *id);
+    }
+
+    // The token of an "Authorization: Bearer <token>" header, if well-formed.
+    std::optional<SessionToken> bearerToken(const HttpRequest &request)
+    {
+        const auto authHeader = request.getHeader("authorization");
+        constexpr std::string_view prefix = "bearer ";
+        if (authHeader.size() <= prefix.size() || !equalsIgnoreCase(authHeader.substr(0, prefix.size()), prefix))
+        {
+            return std::nullopt;
+        }
+        return SessionToken::parse(trim(authHeader.substr(prefix.size())));
+    }
+
+    // Advert fields that are the same for every viewer; leaves the object open.
+    template <typename String>
+    void writeAdFields(JsonWriter<String> &json, const Advertisement &ad, std::string_view ownerName)
+    {
+        json.raw(R"({"id":)").number(ad.id);
+        json.raw(R"(,"title":)").string(ad.title);
+        json.raw(R"(,"description":)").string(ad.description);
+        json.raw(R"(,"price":)").fixed(ad.price, 2);
+        json.raw(R"(,"ownerName":)").string(ownerName);
+        json.raw(R"(,"createdAt":)").number(static_cast<long long>(ad.createdAt));
+    }
+
+    // Fields that depend on who is looking; closes the object. Only the owner
+    // sees the response count.
+    template <typename String>
+    void writeAdViewerFields(JsonWriter<String> &json, bool mine, bool hasResponded, std::optional<size_t> responsesCount)
+    {
+        json.raw(R"(,"mine":)").boolean(mine);
+        if (responsesCount)
+        {
+            json.raw(R"(,"responsesCount":)").number(*responsesCount);
+        }
+        json.raw(R"(,"hasResponded":)").boolean(hasResponded);
+        json.raw('}');
+    }
+
+    // Everything loadSnapshot takes on trust once it starts filling the board:
+    // users_ is indexed by id, no id may be handed out twice, and prices go
+    // into the price index.
+    bool checkSnapshot(const SnapshotFile &snapshot, const std::filesystem::path &path)
+    {
+        const auto userCount = snapshot.userCount();
+        for (size_t i = 0; i < userCount; ++i)
+        {
+            if (snapshot.user(i).id != static_cast<int>(i + 1))
+            {
+                std::cerr << path << ": user ids are not contiguous" << std::endl;
+                return false;
+            }
+        }
+        const auto knownUser = [userCount](int userId)
+        { return userId >= 1 && static_cast<size_t>(userId) <= userCount; };
+        if (static_cast<size_t>(std::max(snapshot.nextUserId(), 0)) <= userCount)
+        {
+            std::cerr << path << ": next user id " << snapshot.nextUserId() << " is already taken" << std::endl;
+            return false;
+        }
+
+        std::unordered_set<int> advertIds;
+        advertIds.reserve(snapshot.advertCount());
+        int maxAdvertId = 0;
+        for (size_t i = 0; i < snapshot.advertCount(); ++i)
+        {
+            const auto advert = snapshot.advert(i);
+            if (advert.id < 1 || !advertIds.insert(advert.id).second)
+            {
+                std::cerr << path << ": advert id " << advert.id << " is invalid or repeated" << std::endl;
+                return false;
+            }
+            if (!knownUser(advert.ownerId))
+            {
+                std::cerr << path << ": advert owned by unknown user " << advert.ownerId << std::endl;
+                return false;
+            }
+            if (!validPrice(advert.price))
+            {
+                std::cerr << path << ": advert " << advert.id << " has invalid price " << advert.price << std::endl;
+                return false;
+            }
+            maxAdvertId = std::max(maxAdvertId, advert.id);
+        }
+        if (snapshot.nextAdvertId() <= maxAdvertId)
+        {
+            std::cerr << path << ": next advert id " << snapshot.nextAdvertId() << " is already taken" << std::endl;
+            return false;
+        }
+
+        for (size_t i = 0; i < snapshot.responseCount(); ++i)
+        {
+            const auto [adId, userId] = snapshot.response(i);
+            if (advertIds.count(adId) == 0 || !knownUser(userId))
+            {
+                std::cerr << path << ": response to advert " << adId << " by user " << userId
+                          << " names an unknown advert or user" << std::endl;
+                return false;
+            }
+        }
+        for (size_t i = 0; i < snapshot.sessionCount(); ++i)
+        {
+            if (const int userId = snapshot.session(i).second; !knownUser(userId))
+            {
+                std::cerr << path << ": session of unknown user " << userId << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+BulletinBoardApp::BulletinBoardApp(const AppOptions &options)
+    : changes_(kChangeLogCapacity),
+      sessions_(options.maxSessions, options.sessionTtl),
+      staticFiles_(options.staticRoot.empty()
+                       ? std::filesystem::path(__FILE__).parent_path().parent_path() / "public"
+                       : options.staticRoot),
+      passwordHasher_(options.hashThreads, options.maxPendingHashes, options.hashIterations),
+      dummyPasswordHash_(hashPassword("", passwordHasher_.iterations())),
+      metrics_(metricRouteLabels()),
+      compressionLevel_(options.compressionLevel),
+      compressionMinSize_(options.compressionMinSize),
+      rateLimiter_({perMinute(options.apiRatePerMinute), perMinute(options.authRatePerMinute),
+                    perMinute(options.writeRatePerMinute)},
+                   kRateLimitBuckets)
+{
+    // Expired and evicted sessions must stay gone after a restart.
+    sessions_.setDropListener([this](const SessionToken &token)
+                              {
+        if (wal_)
+        {
+            wal_->sessionClosed(token.hex());
+        } });
+}
+
+BulletinBoardApp::~BulletinBoardApp()
+{
+    stopIndexing_ = true;
+    if (indexer_.joinable())
+    {
+        indexer_.join();
+    }
+}
+
+void BulletinBoardApp::seedDemoData()
+{
+    // Create demo users and adverts
+    User demo;
+    demo.id = nextUserId_++;
+    demo.name = "Demo User";
+    demo.email = "demo@example.com";
+    demo.passwordHash = hashPassword("demo123", passwordHasher_.iterations());
+    users_.push_back(demo);
+    emailToUserId_[demo.email] = demo.id;
+
+    User alice;
+    alice.id = nextUserId_++;
+    alice.name = "Alice Smith";
+    alice.email = "alice@example.com";
+    alice.passwordHash = hashPassword("alice123", passwordHasher_.iterations());
+    users_.push_back(alice);
+    emailToUserId_[alice.email] = alice.id;
+
+    Advertisement sample;
+    sample.id = nextAdvertId_++;
+    sample.ownerId = demo.id;
+    sample.title = "Vintage Bicycle";
+    sample.description = "Reliable city bike. Recently serviced.";
+    sample.price = 150.0;
+    sample.createdAt = std::time(nullptr);
+    adverts_.insert(sample);
+
+    Advertisement sample2;
+    sample2.id = nextAdvertId_++;
+    sample2.ownerId = demo.id;
+    sample2.title = "Gaming Laptop";
+    sample2.description = "15\" display, RTX graphics, 16GB RAM.";
+    sample2.price = 950.0;
+    sample2.createdAt = std::time(nullptr);
+    adverts_.insert(sample2);
+
+    Advertisement sample3;
+    sample3.id = nextAdvertId_++;
+    sample3.ownerId = alice.id;
+    sample3.title = "iPhone 14 Pro";
+    sample3.description = "Mint condition, 256GB, with original box and accessories.";
+    sample3.price = 750.0;
+    sample3.createdAt = std::time(nullptr);
+    adverts_.insert(sample3);
+    advertsChanged();
+
+    adverts_.forEach([this](const Advertisement &ad)
+                     { searchIndex_.add(ad.id, ad.createdAt, ad.title, ad.description); });
+}
+
+bool BulletinBoardApp::loadSnapshot(const std::filesystem::path &path)
+{
+    const auto snapshot = SnapshotFile::open(path);
+    if (!snapshot)
+    {
+        return false;
+    }
+    if (!checkSnapshot(*snapshot, path))
+    {
+        return false;
+    }
+    const auto userCount = snapshot->userCount();
+    const auto advertCount = snapshot->advertCount();
+
+    std::vector<int> advertIds;
+    advertIds.reserve(advertCount);
+    {
+        std::unique_lock advertsLock(advertsMutex_);
+        std::unique_lock usersLock(usersMutex_);
+        users_.reserve(userCount);
+        emailToUserId_.reserve(userCount);
+        for (size_t i = 0; i < userCount; ++i)
+        {
+            const auto view = snapshot->user(i);
+            User user;
+            user.id = view.id;
+            user.name = view.name;
+            user.email = view.email;
+            user.passwordHash = view.passwordHash;
+            emailToUserId_.emplace(user.email, user.id);
+            users_.push_back(std::move(user));
+        }
+        nextUserId_ = snapshot->nextUserId();
+
+        adverts_.reserve(advertCount);
+        for (size_t i = 0; i < advertCount; ++i)
+        {
+            const auto view = snapshot->advert(i);
+            Advertisement advert;
+            advert.id = view.id;
+            advert.ownerId = view.ownerId;
+            advert.price = view.price;
+            advert.createdAt = view.createdAt;
+            advert.title = view.title;
+            advert.description = view.description;
+            adverts_.insert(std::move(advert));
+            advertIds.push_back(view.id);
+        }
+        nextAdvertId_ = snapshot->nextAdvertId();
+        advertsChanged();
+
+        for (size_t i = 0; i < snapshot->responseCount(); ++i)
+        {
+            const auto [adId, userId] = snapshot->response(i);
+            responses_.add(adId, userId);
+        }
+        for (size_t i = 0; i < snapshot->sessionCount(); ++i)
+        {
+            const auto [token, userId] = snapshot->session(i);
+            if (const auto parsed = SessionToken::parse(token))
+            {
+                sessions_.put(*parsed, userId);
+            }
+        }
+    }
+    indexInBackground(std::move(advertIds));
+    return true;
+}
+
+bool BulletinBoardApp::dumpSnapshot(const std::filesystem::path &path) const
+{
+    return SnapshotFile::write(path, captureState());
+}
+
+void BulletinBoardApp::indexInBackground(std::vector<int> advertIds)
+{
+    if (indexer_.joinable())
+    {
+        indexer_.join();
+    }
+    searchReady_ = false;
+    indexer_ = std::thread([this, advertIds = std::move(advertIds)]()
+                           {
+        // Short lock holds so creates and deletes are not stalled behind the
+        // whole load. Adverts deleted meanwhile are simply skipped.
+        constexpr size_t kChunk = 4096;
+        for (size_t begin = 0; begin < advertIds.size() && !stopIndexing_; begin += kChunk)
+        {
+            const size_t end = std::min(advertIds.size(), begin + kChunk);
+            std::shared_lock advertsLock(advertsMutex_);
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (const auto *ad = adverts_.find(advertIds[i]))
+                {
+                    searchIndex_.add(ad->id, ad->createdAt, ad->title, ad->description);
+                }
+            }
+        }
+        searchReady_ = true; });
+}
+
+bool BulletinBoardApp::openDataDirectory(const std::filesystem::path &directory,
+                                         const std::optional<std::filesystem::path> &initialSnapshot)
+{
+    wal_ = std::make_unique<WriteAheadLog>(directory);
+    PersistedState state;
+    if (!wal_->recover(state))
+    {
+        return false;
+    }
+    const bool fresh = state.empty();
+    if (fresh && initialSnapshot)
+    {
+        if (!loadSnapshot(*initialSnapshot))
+        {
+            return false;
+        }
+    }
+    else if (fresh)
+    {
+        seedDemoData();
+    }
+    else
+    {
+        loadState(std::move(state));
+    }
+    if (!wal_->open([this]()
+                    { return captureState(); }))
+    {
+        return false;
+    }
+    // The initial data never went through the log, so record it as a snapshot.
+    return !fresh || wal_->snapshot();
+}
+
+PersistedState BulletinBoardApp::captureState() const
+{
+    PersistedState state;
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+    state.users = users_;
+    state.nextUserId = nextUserId_;
+    state.nextAdvertId = nextAdvertId_;
+    state.adverts.reserve(adverts_.size());
+    adverts_.forEach([&state](const Advertisement &ad)
+                     { state.adverts.push_back(ad); });
+    responses_.forEach([&state](int adId, int userId)
+                       { state.responses.emplace_back(adId, userId); });
+    sessions_.forEach([&state](const SessionToken &token, int userId)
+                      { state.sessions.emplace_back(token.hex(), userId); });
+    return state;
+}
+
+void BulletinBoardApp::loadState(PersistedState state)
+{
+    std::unique_lock advertsLock(advertsMutex_);
+    std::unique_lock usersLock(usersMutex_);
+    users_ = std::move(state.users);
+    for (const auto &user : users_)
+    {
+        emailToUserId_[user.email] = user.id;
+    }
+    nextUserId_ = state.nextUserId;
+    nextAdvertId_ = state.nextAdvertId;
+    std::vector<int> advertIds;
+    advertIds.reserve(state.adverts.size());
+    adverts_.reserve(state.adverts.size());
+    for (auto &advert : state.adverts)
+    {
+        advertIds.push_back(advert.id);
+        adverts_.insert(std::move(advert));
+    }
+    advertsChanged();
+    for (const auto &[adId, userId] : state.responses)
+    {
+        responses_.add(adId, userId);
+    }
+    for (const auto &[token, userId] : state.sessions)
+    {
+        if (const auto parsed = SessionToken::parse(token))
+        {
+            sessions_.put(*parsed, userId);
+        }
+    }
+    usersLock.unlock();
+    advertsLock.unlock();
+    indexInBackground(std::move(advertIds));
+}
+
+void BulletinBoardApp::advertsChanged()
+{
+    ++advertsVersion_;
+    advertCount_.store(adverts_.size(), std::memory_order_relaxed);
+}
+
+void BulletinBoardApp::removeAdvert(int advertId)
+{
+    const auto *advert = adverts_.find(advertId);
+    if (!advert)
+    {
+        return;
+    }
+    searchIndex_.remove(advertId, advert->title, advert->description);
+    adverts_.erase(advertId);
+    advertsChanged();
+    // Удаляем также все отклики на это объявление
+    responses_.eraseAd(advertId);
+    changes_.record(advertId, ChangeLog::Kind::Removed);
+}
+
+bool BulletinBoardApp::awaitDurable(uint64_t sequence, HttpResponse &response) const
+{
+    if (!wal_ || wal_->waitDurable(sequence))
+    {
+        return true;
+    }
+    response.status = 500;
+    response.body = R"({"error":"Failed to save changes"})";
+    return false;
+}
+
+void BulletinBoardApp::run(const ServerOptions &options)
+{
+    HttpServer server(options, [this](const HttpRequest &request, HttpResponse &response)
+                      { routeRequest(request, response); });
+    // Requests reach the workers through the pool's queue, after this store.
+    server_ = &server;
+    std::cout << "BulletinBoard running on http://localhost:" << options.port << std::endl;
+    server.run();
+    server_ = nullptr;
+}
+
+void BulletinBoardApp::routeRequest(const HttpRequest &request, HttpResponse &response)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const size_t route = dispatchRequest(request, response);
+    // Static files come precompressed, or are not worth compressing at all.
+    if (route < router().routes().size())
+    {
+        compressResponse(request, response);
+    }
+    metrics_.record(route, response.status, std::chrono::steady_clock::now() - started);
+}
+
+size_t BulletinBoardApp::dispatchRequest(const HttpRequest &request, HttpResponse &response)
+{
+    const size_t staticRoute = router().routes().size();
+    const size_t unmatchedRoute = staticRoute + 1;
+
+    size_t route = unmatchedRoute;
+    if (router().dispatch(*this, request, response, route, &BulletinBoardApp::admitRequest))
+    {
+        return route;
+    }
+
+    static const std::string apiPrefix = "/api/";
+    if (request.path.rfind(apiPrefix, 0) == 0)
+    {
+        response.status = 404;
+        response.body = R"({"error":"Endpoint not found"})";
+        return unmatchedRoute;
+    }
+
+    if (!serveStatic(request, response))
+    {
+        response.status = 404;
+        response.contentType = "text/plain; charset=utf-8";
+        response.body = "Not Found";
+        return unmatchedRoute;
+    }
+    return staticRoute;
+}
+
+void BulletinBoardApp::compressResponse(const HttpRequest &request, HttpResponse &response) const
+{
+    if (compressionLevel_ == 0 || response.eventStream || response.file ||
+        response.bodySize() < compressionMinSize_)
+    {
+        return;
+    }
+    response.setHeader("Vary", "Accept-Encoding");
+    const auto coding = negotiateCoding(request.getHeader("Accept-Encoding"));
+    if (coding == ContentCoding::Identity)
+    {
+        return;
+    }
+
+    if (response.sharedBody)
+    {
+        {
+            std::lock_guard lock(compressedMutex_);
+            if (compressedShared_.coding == coding && compressedShared_.source.lock() == response.sharedBody)
+            {
+                response.sharedBody = compressedShared_.body;
+                response.setHeader("Content-Encoding", codingName(coding));
+                return;
+            }
+        }
+        // Concurrent misses compress the same body twice, which beats
+        // holding everyone else up behind the lock meanwhile.
+        auto compressed = std::make_shared<std::string>();
+        if (!compressBody(*response.sharedBody, coding, compressionLevel_, *compressed) ||
+            compressed->size() >= response.sharedBody->size())
+        {
+            return;
+        }
+        {
+            std::lock_guard lock(compressedMutex_);
+            compressedShared_ = {response.sharedBody, coding, compressed};
+        }
+        response.sharedBody = std::move(compressed);
+        response.setHeader("Content-Encoding", codingName(coding));
+        return;
+    }
+
+    std::pmr::string compressed(response.body.get_allocator());
+    if (!compressBody(response.body, coding, compressionLevel_, compressed) ||
+        compressed.size() >= response.body.size())
+    {
+        return;
+    }
+    response.body.swap(compressed);
+    response.setHeader("Content-Encoding", codingName(coding));
+}
+
+const Router<BulletinBoardApp> &BulletinBoardApp::router()
+{
+    // Literal segments take precedence over {id}, so "/api/ads/search" is
+    // never read as an advert id; an id that is not a number is a 404.
+    static constexpr Route<BulletinBoardApp> routes[] = {
+        route<&BulletinBoardApp::handleRegister>(HttpMethod::Post, "/api/register", kAuthLimit),
+        route<&BulletinBoardApp::handleLogin>(HttpMethod::Post, "/api/login", kAuthLimit),
+        route<&BulletinBoardApp::handleLogout>(HttpMethod::Post, "/api/logout"),
+        route<&BulletinBoardApp::handleSession>(HttpMethod::Get, "/api/session"),
+        route<&BulletinBoardApp::handleAdsList>(HttpMethod::Get, "/api/ads"),
+        route<&BulletinBoardApp::handleCreateAd>(HttpMethod::Post, "/api/ads", kWriteLimit),
+        route<&BulletinBoardApp::handleSearchAds>(HttpMethod::Get, "/api/ads/search"),
+        route<&BulletinBoardApp::handleAdsChanges>(HttpMethod::Get, "/api/ads/changes"),
+        route<&BulletinBoardApp::handleMyResponses>(HttpMethod::Get, "/api/ads/my-responses"),
+        route<&BulletinBoardApp::handleDeleteAd>(HttpMethod::Delete, "/api/ads/{id}", kWriteLimit),
+        route<&BulletinBoardApp::handleRespondToAd>(HttpMethod::Post, "/api/ads/{id}/respond", kWriteLimit),
+        route<&BulletinBoardApp::handleAdResponders>(HttpMethod::Get, "/api/ads/{id}/responders"),
+        route<&BulletinBoardApp::handleEvents>(HttpMethod::Get, "/api/events"),
+        route<&BulletinBoardApp::handleMetrics>(HttpMethod::Get, "/metrics"),
+    };
+    static const Router<BulletinBoardApp> router(routes);
+    return router;
+}
+
+std::vector<std::string> BulletinBoardApp::metricRouteLabels()
+{
+    std::vector<std::string> labels;
+    for (const auto &route : router().routes())
+    {
+        labels.push_back(std::string(methodName(route.method)) + " " + std::string(route.pattern));
+    }
+    labels.emplace_back("static");
+    labels.emplace_back("unmatched");
+    return labels;
+}
+
+bool BulletinBoardApp::serveStatic(const HttpRequest &request, HttpResponse &response) const
+{
+    const auto asset = staticFiles_.find(request.path);
+    if (!asset)
+    {
+        return false;
+    }
+
+    const char *contentEncoding = nullptr;
+    const auto &variant = selectVariant(*asset, request.getHeader("accept-encoding"), contentEncoding);
+    response.setHeader("Cache-Control", "no-cache");
+    response.setHeader("ETag", variant.etag);
+    if (!asset->gzip.empty() || !asset->brotli.empty())
+    {
+        response.setHeader("Vary", "Accept-Encoding");
+    }
+    if (etagMatches(request.getHeader("if-none-match"), variant.etag))
+    {
+        response.status = 304;
+        return true;
+    }
+
+    if (contentEncoding)
+    {
+        response.setHeader("Content-Encoding", contentEncoding);
+    }
+    response.contentType = asset->contentType;
+    variant.attachTo(response);
+    return true;
+}
+
+bool BulletinBoardApp::admitRequest(BulletinBoardApp &app, const Route<BulletinBoardApp> &route,
+                                    const HttpRequest &request, HttpResponse &response)
+{
+    // Addresses are keys below 2^32; sessions are keyed by their token with
+    // the top bit set, so the two never meet. Only a token of a live session
+    // gets its own write bucket: anything else that looks like one is
+    // counted against the address, or made-up tokens would each start with a
+    // full bucket.
+    const uint64_t address = request.remoteAddress;
+    uint64_t writer = address;
+    if (route.rateLimit == kWriteLimit)
+    {
+        if (const auto token = bearerToken(request); token && app.sessions_.find(*token))
+        {
+            writer = (token->words[0] ^ token->words[1]) | (uint64_t(1) << 63);
+        }
+    }
+
+    uint32_t retryAfter = 0;
+    const bool admitted =
+        app.rateLimiter_.tryAcquire(kApiLimit, address, retryAfter) &&
+        (route.rateLimit != kAuthLimit || app.rateLimiter_.tryAcquire(kAuthLimit, address, retryAfter)) &&
+        (route.rateLimit != kWriteLimit || app.rateLimiter_.tryAcquire(kWriteLimit, writer, retryAfter));
+    if (admitted)
+    {
+        return true;
+    }
+    char seconds[16];
+    const auto end = std::to_chars(seconds, seconds + sizeof(seconds), retryAfter).ptr;
+    response.status = 429;
+    response.setHeader("Retry-After", std::string_view(seconds, static_cast<size_t>(end - seconds)));
+    response.body = R"({"error":"Too many requests"})";
+    return false;
+}
+
+std::optional<int> BulletinBoardApp::authenticate(const HttpRequest &request) const
+{
+    const auto token = bearerToken(request);
+    return token ? sessions_.find(*token) : std::nullopt;
+}
+
+void BulletinBoardApp::handleRegister(const HttpRequest &request, HttpResponse &response)
+{
+    const auto name = request.getParam("name");
+    const std::string email(request.getParam("email"));
+    const auto password = request.getParam("password");
+    if (name.empty() || email.empty() || password.empty())
+    {
+        response.status = 400;
+        response.body = R"({"error":"All fields are required"})";
+        return;
+    }
+
+    auto passwordHash = passwordHasher_.hash(std::string(password));
+    if (!passwordHash)
+    {
+        response.status = 503;
+        response.setHeader("Retry-After", "1");
+        response.body = R"({"error":"Server is busy, try again later"})";
+        return;
+    }
+    std::unique_lock lock(usersMutex_);
+    if (emailToUserId_.count(email) > 0)
+    {
+        response.status = 409;
+        response.body = R"({"error":"Email already registered"})";
+        return;
+    }
+
+    User user;
+    user.id = nextUserId_++;
+    user.name = name;
+    user.email = email;
+    user.passwordHash = std::move(*passwordHash);
+    users_.push_back(user);
+    emailToUserId_[email] = user.id;
+    const uint64_t sequence = wal_ ? wal_->userRegistered(user) : 0;
+    lock.unlock();
+
+    if (!awaitDurable(sequence, response))
+    {
+        // The id stays taken (users_ is indexed by it); the account just
+        // cannot be reached, and the email is free again.
+        std::unique_lock rollbackLock(usersMutex_);
+        emailToUserId_.erase(email);
+        users_[user.id - 1].email.clear();
+        users_[user.id - 1].passwordHash.clear();
+        return;
+    }
+    response.body = R"({"success":true,"message":"Registration complete"})";
+}
+
+void BulletinBoardApp::handleLogin(const HttpRequest &request, HttpResponse &response)
+{
+    const std::string email(request.getParam("email"));
+    const auto password = request.getParam("password");
+    if (email.empty() || password.empty())
+    {
+        response.status = 400;
+        response.body = R"({"error":"Email and password are required"})";
+        return;
+    }
+
+    std::optional<User> user;
+    {
+        std::shared_lock lock(usersMutex_);
+        if (auto it = emailToUserId_.find(email); it != emailToUserId_.end())
+        {
+            user = users_[it->second - 1];
+        }
+    }
+    // An unknown email still pays for a full hash, so response times do not
+    // tell which emails are registered.
+    const auto verified =
+        passwordHasher_.verify(std::string(password), user ? user->passwordHash : dummyPasswordHash_);
+    if (!verified)
+    {
+        response.status = 503;
+        response.setHeader("Retry-After", "1");
+        response.body = R"({"error":"Server is busy, try again later"})";
+        return;
+    }
+    if (!user || !*verified)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Invalid credentials"})";
+        return;
+    }
+
+    const auto token = SessionToken::generate();
+    const auto tokenHex = token.hex();
+    sessions_.put(token, user->id);
+    if (!awaitDurable(wal_ ? wal_->sessionOpened(tokenHex, user->id) : 0, response))
+    {
+        sessions_.erase(token);
+        return;
+    }
+
+    JsonWriter json(response.body);
+    json.raw(R"({"token":)").string(tokenHex).raw(R"(,"user":)");
+    writeUserJson(json, *user);
+    json.raw('}');
+}
+
+void BulletinBoardApp::handleLogout(const HttpRequest &request, HttpResponse &response)
+{
+    // Only a session that existed is journalled; anyone may send a logout
+    // with a made-up token, and those must not grow the log.
+    if (const auto token = bearerToken(request); token && sessions_.erase(*token))
+    {
+        if (!awaitDurable(wal_ ? wal_->sessionClosed(token->hex()) : 0, response))
+        {
+            return;
+        }
+    }
+
+    response.body = R"({"success":true})";
+}
+
+void BulletinBoardApp::handleSession(const HttpRequest &request, HttpResponse &response)
+{
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.body = R"({"authenticated":false})";
+        return;
+    }
+
+    std::shared_lock lock(usersMutex_);
+    const User &user = users_[*userId - 1];
+    JsonWriter json(response.body);
+    json.raw(R"({"authenticated":true,"user":)");
+    writeUserJson(json, user);
+    json.raw('}');
+}
+
+void BulletinBoardApp::handleAdsList(const HttpRequest &request, HttpResponse &response)
+{
+    const auto userId = authenticate(request);
+    if (request.query.empty())
+    {
+        buildAdsJson(userId.value_or(0), response);
+        return;
+    }
+
+    // Без параметров отдаём весь список; limit/cursor/sort/фильтры включают постраничную выдачу
+    const auto fail = [&response](const char *body)
+    {
+        response.status = 400;
+        response.body = body;
+    };
+
+    AdvertQuery query;
+    const auto sort = request.getParam("sort");
+    if (sort.empty() || sort == "oldest")
+        query.sort = AdvertQuery::Sort::Oldest;
+    else if (sort == "newest")
+        query.sort = AdvertQuery::Sort::Newest;
+    else if (sort == "price_asc")
+        query.sort = AdvertQuery::Sort::PriceAsc;
+    else if (sort == "price_desc")
+        query.sort = AdvertQuery::Sort::PriceDesc;
+    else
+        return fail(R"({"error":"Invalid sort"})");
+
+    if (const auto limit = request.getParam("limit"); !limit.empty())
+    {
+        const auto value = parseNumber<size_t>(limit);
+        if (!value || *value == 0)
+        {
+            return fail(R"({"error":"Invalid limit"})");
+        }
+        query.limit = std::min(*value, kMaxPageSize);
+    }
+    if (const auto cursor = request.getParam("cursor"); !cursor.empty())
+    {
+        query.after = decodeCursor(cursor);
+        if (!query.after)
+        {
+            return fail(R"({"error":"Invalid cursor"})");
+        }
+    }
+    const auto minPrice = request.getParam("minPrice");
+    const auto maxPrice = request.getParam("maxPrice");
+    if ((!minPrice.empty() && !(query.minPrice = parsePrice(minPrice))) ||
+        (!maxPrice.empty() && !(query.maxPrice = parsePrice(maxPrice))))
+    {
+        return fail(R"({"error":"Invalid price range"})");
+    }
+    if (const auto owner = request.getParam("owner"); !owner.empty())
+    {
+        if (owner == "me")
+        {
+            if (!userId)
+            {
+                response.status = 401;
+                response.body = R"({"error":"Authentication required"})";
+                return;
+            }
+            query.ownerId = *userId;
+        }
+        else if (!(query.ownerId = parseNumber<int>(owner)))
+        {
+            return fail(R"({"error":"Invalid owner"})");
+        }
+    }
+
+    buildAdsPageJson(userId.value_or(0), query, response.body);
+}
+
+void BulletinBoardApp::handleSearchAds(const HttpRequest &request, HttpResponse &response)
+{
+    const auto userId = authenticate(request);
+    const auto query = request.getParam("q");
+    if (query.empty())
+    {
+        response.status = 400;
+        response.body = R"({"error":"Search query is required"})";
+        return;
+    }
+
+    size_t limit = kDefaultSearchLimit;
+    if (const auto limitStr = request.getParam("limit"); !limitStr.empty())
+    {
+        const auto value = parseNumber<size_t>(limitStr);
+        if (!value || *value == 0)
+        {
+            response.status = 400;
+            response.body = R"({"error":"Invalid limit"})";
+            return;
+        }
+        limit = std::min(*value, kMaxPageSize);
+    }
+
+    if (!searchReady_)
+    {
+        response.status = 503;
+        response.setHeader("Retry-After", "1");
+        response.body = R"({"error":"Search index is still loading"})";
+        return;
+    }
+    const auto hits = searchIndex_.search(query, limit, std::time(nullptr));
+
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+    response.body.reserve(hits.size() * kAdJsonSizeHint + 16);
+    JsonWriter json(response.body);
+    json.raw(R"({"ads":[)");
+    bool first = true;
+    for (const auto &hit : hits)
+    {
+        // Объявление могло быть удалено после поиска
+        const auto *ad = adverts_.find(hit.adId);
+        if (!ad)
+        {
+            continue;
+        }
+        if (!first)
+        {
+            json.raw(',');
+        }
+        first = false;
+        writeAdJson(json, *ad, userId.value_or(0));
+    }
+    json.raw("]}");
+}
+
+void BulletinBoardApp::handleAdsChanges(const HttpRequest &request, HttpResponse &response)
+{
+    const int userId = authenticate(request).value_or(0);
+    std::optional<uint64_t> since;
+    if (const auto sinceStr = request.getParam("since"); !sinceStr.empty())
+    {
+        since = parseNumber<uint64_t>(sinceStr);
+        if (!since)
+        {
+            response.status = 400;
+            response.body = R"({"error":"Invalid since"})";
+            return;
+        }
+    }
+
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+    uint64_t sequence = 0;
+    const auto changes = since ? changes_.since(*since, sequence) : std::nullopt;
+    if (!changes)
+    {
+        // The whole list, as /api/ads sends it, with the sequence it is
+        // current as of. Read first: a response recorded while the list is
+        // rendered is sent again next time rather than missed.
+        sequence = changes_.sequence();
+        const auto snapshot = adsListSnapshot();
+        if (userId == 0)
+        {
+            response.body.assign(snapshot->body);
+        }
+        else
+        {
+            writeViewerAdsList(*snapshot, userId, response.body);
+        }
+        response.body.pop_back();
+        JsonWriter(response.body).raw(R"(,"sequence":)").number(sequence).raw(R"(,"resync":true})");
+        return;
+    }
+
+    // Only the advert's current state matters, however often it changed.
+    // Sorting by id keeps "added" in list order, as ids only grow.
+    std::vector<ChangeLog::Change> touched = *changes;
+    std::stable_sort(touched.begin(), touched.end(), [](const auto &lhs, const auto &rhs)
+                     { return lhs.adId < rhs.adId; });
+    std::vector<const Advertisement *> added;
+    std::vector<const Advertisement *> updated;
+    std::vector<int> removed;
+    for (size_t i = 0; i < touched.size();)
+    {
+        const int adId = touched[i].adId;
+        bool isNew = false;
+        for (; i < touched.size() && touched[i].adId == adId; ++i)
+        {
+            isNew = isNew || touched[i].kind == ChangeLog::Kind::Added;
+        }
+        if (const auto *advert = adverts_.find(adId))
+        {
+            (isNew ? added : updated).push_back(advert);
+        }
+        else if (!isNew)
+        {
+            // One that came and went in between was never seen by the client.
+            removed.push_back(adId);
+        }
+    }
+
+    response.body.reserve((added.size() + updated.size()) * kAdJsonSizeHint + removed.size() * 8 + 64);
+    JsonWriter json(response.body);
+    json.raw(R"({"sequence":)").number(sequence);
+    const auto writeAds = [&](std::string_view key, const std::vector<const Advertisement *> &ads)
+    {
+        json.raw(R"(,")").raw(key).raw(R"(":[)");
+        for (size_t i = 0; i < ads.size(); ++i)
+        {
+            if (i > 0)
+            {
+                json.raw(',');
+            }
+            writeAdJson(json, *ads[i], userId);
+        }
+        json.raw(']');
+    };
+    writeAds("added", added);
+    writeAds("updated", updated);
+    json.raw(R"(,"removed":[)");
+    for (size_t i = 0; i < removed.size(); ++i)
+    {
+        if (i > 0)
+        {
+            json.raw(',');
+        }
+        json.number(removed[i]);
+    }
+    json.raw("]}");
+}
+
+void BulletinBoardApp::handleCreateAd(const HttpRequest &request, HttpResponse &response)
+{
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Authentication required"})";
+        return;
+    }
+
+    const auto title = request.getParam("title");
+    const auto description = request.getParam("description");
+    const auto priceStr = request.getParam("price");
+
+    if (title.empty() || description.empty())
+    {
+        response.status = 400;
+        response.body = R"({"error":"Title and description are required"})";
+        return;
+    }
+
+    double price = 0.0;
+    if (!priceStr.empty())
+    {
+        const auto parsed = parsePrice(priceStr);
+        if (!parsed)
+        {
+            response.status = 400;
+            response.body = R"({"error":"Invalid price"})";
+            return;
+        }
+        price = *parsed;
+    }
+
+    uint64_t sequence = 0;
+    int advertId = 0;
+    std::string event;
+    {
+        Advertisement advert;
+        advert.ownerId = *userId;
+        advert.title = title;
+        advert.description = description;
+        advert.price = price;
+        advert.createdAt = std::time(nullptr);
+
+        std::unique_lock lock(advertsMutex_);
+        advert.id = nextAdvertId_++;
+        const auto &stored = adverts_.insert(std::move(advert));
+        advertId = stored.id;
+        searchIndex_.add(stored.id, stored.createdAt, stored.title, stored.description);
+        advertsChanged();
+        changes_.record(stored.id, ChangeLog::Kind::Added);
+        if (wal_)
+        {
+            sequence = wal_->advertCreated(stored);
+        }
+        if (hasEventStreams())
+        {
+            // As an anonymous viewer sees it, plus the owner so clients can tell their own.
+            std::shared_lock usersLock(usersMutex_);
+            JsonWriter json(event);
+            writeAdFields(json, stored, users_[stored.ownerId - 1].name);
+            json.raw(R"(,"ownerId":)").number(stored.ownerId);
+            writeAdViewerFields(json, false, false, std::nullopt);
+        }
+    }
+
+    if (!awaitDurable(sequence, response))
+    {
+        // Others may have seen it in the list or even responded meanwhile;
+        // to them it looks deleted by its owner.
+        std::unique_lock lock(advertsMutex_);
+        removeAdvert(advertId);
+        return;
+    }
+    response.body = R"({"success":true})";
+    if (!event.empty())
+    {
+        publishEvent("ad-created", event);
+    }
+}
+
+void BulletinBoardApp::handleDeleteAd(const HttpRequest &request, HttpResponse &response, int advertId)
+{
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Authentication required"})";
+        return;
+    }
+
+    std::unique_lock lock(advertsMutex_);
+    const auto *advert = adverts_.find(advertId);
+    if (!advert)
+    {
+        response.status = 404;
+        response.body = R"({"error":"Advertisement not found"})";
+        return;
+    }
+    if (advert->ownerId != *userId)
+    {
+        response.status = 403;
+        response.body = R"({"error":"You can only delete your own advertisements"})";
+        return;
+    }
+    // What it takes to put the advert back should the journal fail.
+    std::optional<Advertisement> removed;
+    std::vector<int> responders;
+    if (wal_)
+    {
+        removed = *advert;
+        responders = responses_.responders(advertId);
+    }
+    removeAdvert(advertId);
+    const uint64_t sequence = wal_ ? wal_->advertDeleted(advertId) : 0;
+    lock.unlock();
+
+    if (!awaitDurable(sequence, response))
+    {
+        lock.lock();
+        const auto &restored = adverts_.restore(std::move(*removed));
+        searchIndex_.add(restored.id, restored.createdAt, restored.title, restored.description);
+        advertsChanged();
+        for (int responder : responders)
+        {
+            responses_.add(advertId, responder);
+        }
+        changes_.record(advertId, ChangeLog::Kind::Added);
+        return;
+    }
+    response.body = R"({"success":true})";
+    if (hasEventStreams())
+    {
+        std::string event;
+        JsonWriter(event).raw(R"({"id":)").number(advertId).raw('}');
+        publishEvent("ad-deleted", event);
+    }
+}
+
+void BulletinBoardApp::handleRespondToAd(const HttpRequest &request, HttpResponse &response, int advertId)
+{
+    // Проверка аутентификации
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Authentication required"})";
+        return;
+    }
+
+    // Shared lock keeps the advert from being deleted until the response is stored
+    std::shared_lock lock(advertsMutex_);
+
+    // Проверка существования объявления
+    const auto *advert = adverts_.find(advertId);
+    if (!advert)
+    {
+        response.status = 404;
+        response.body = R"({"error":"Advertisement not found"})";
+        return;
+    }
+
+    // Проверка: пользователь не может откликнуться на своё объявление
+    if (advert->ownerId == *userId)
+    {
+        response.status = 400;
+        response.body = R"({"error":"You cannot respond to your own advertisement"})";
+        return;
+    }
+
+    // Добавление отклика, если пользователь ещё не откликался на это объявление
+    if (!responses_.add(advertId, *userId))
+    {
+        response.status = 409;
+        response.body = R"({"error":"You have already responded to this advertisement"})";
+        return;
+    }
+    const uint64_t sequence = wal_ ? wal_->responseAdded(advertId, *userId) : 0;
+    // The owner's count and the responder's flag changed.
+    changes_.record(advertId, ChangeLog::Kind::Updated);
+    // Only the owner hears about responses, as only the owner sees their count.
+    const int ownerId = advert->ownerId;
+    std::string event;
+    if (hasEventStreams())
+    {
+        JsonWriter json(event);
+        json.raw(R"({"adId":)").number(advertId);
+        json.raw(R"(,"responsesCount":)").number(responses_.summary(advertId, ownerId).count);
+        json.raw('}');
+    }
+    lock.unlock();
+
+    if (!awaitDurable(sequence, response))
+    {
+        responses_.remove(advertId, *userId);
+        changes_.record(advertId, ChangeLog::Kind::Updated);
+        return;
+    }
+    response.body = R"({"success":true})";
+    if (!event.empty())
+    {
+        publishEvent("ad-responses", event, ownerId);
+    }
+}
+
+void BulletinBoardApp::handleMyResponses(const HttpRequest &request, HttpResponse &response)
+{
+    // Проверка аутентификации
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Authentication required"})";
+        return;
+    }
+
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+
+    // Собираем все объявления, на которые откликнулся пользователь
+    const auto adIds = responses_.adsRespondedBy(*userId);
+    response.body.reserve(adIds.size() * kAdJsonSizeHint + 16);
+    JsonWriter json(response.body);
+    json.raw(R"({"ads":[)");
+
+    bool first = true;
+    for (int adId : adIds)
+    {
+        // Находим само объявление
+        if (const auto *adIt = adverts_.find(adId))
+        {
+            const auto &ad = *adIt;
+            const auto &owner = users_[ad.ownerId - 1];
+
+            if (!first)
+            {
+                json.raw(',');
+            }
+            first = false;
+
+            writeAdFields(json, ad, owner.name);
+            json.raw(R"(,"hasResponded":true})");
+        }
+    }
+
+    json.raw("]}");
+}
+
+void BulletinBoardApp::handleAdResponders(const HttpRequest &request, HttpResponse &response, int advertId)
+{
+    // Проверка аутентификации
+    const auto userId = authenticate(request);
+    if (!userId)
+    {
+        response.status = 401;
+        response.body = R"({"error":"Authentication required"})";
+        return;
+    }
+
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+
+    // Находим объявление
+    const auto *adIt = adverts_.find(advertId);
+    if (!adIt)
+    {
+        response.status = 404;
+        response.body = R"({"error":"Advertisement not found"})";
+        return;
+    }
+
+    // Проверяем, что запрашивающий является автором объявления
+    if (adIt->ownerId != *userId)
+    {
+        response.status = 403;
+        response.body = R"({"error":"Only the owner can view responders"})";
+        return;
+    }
+
+    // Собираем список пользователей, откликнувшихся на это объявление
+    JsonWriter json(response.body);
+    json.raw(R"({"responders":[)");
+
+    bool first = true;
+    for (int responderId : responses_.responders(advertId))
+    {
+        // users_ is indexed by id - 1
+        if (responderId >= 1 && static_cast<size_t>(responderId) <= users_.size())
+        {
+            if (!first)
+            {
+                json.raw(',');
+            }
+            first = false;
+            writeUserJson(json, users_[static_cast<size_t>(responderId) - 1]);
+        }
+    }
+
+    json.raw("]}");
+}
+
+void BulletinBoardApp::handleMetrics(const HttpRequest &, HttpResponse &response)
+{
+    // Everything here is read from atomics; nothing waits for a request thread.
+    response.contentType = "text/plain; version=0.0.4; charset=utf-8";
+    MetricsWriter metrics(response.body);
+    metrics_.write(metrics);
+
+    metrics.family("bb_active_connections", "gauge", "Open client connections.");
+    metrics.sample("bb_active_connections", {}, uint64_t(server_ ? server_->activeConnections() : 0));
+    metrics.family("bb_event_streams", "gauge", "Open /api/events streams.");
+    metrics.sample("bb_event_streams", {}, uint64_t(server_ ? server_->eventStreams() : 0));
+    metrics.family("bb_rate_limit_buckets", "gauge", "Clients tracked by the rate limiter.");
+    metrics.sample("bb_rate_limit_buckets", {}, uint64_t(rateLimiter_.size()));
+    metrics.family("bb_sessions", "gauge", "Live login sessions.");
+    metrics.sample("bb_sessions", {}, uint64_t(sessions_.size()));
+    metrics.family("bb_adverts", "gauge", "Adverts on the board.");
+    metrics.sample("bb_adverts", {}, uint64_t(advertCount_.load(std::memory_order_relaxed)));
+
+    metrics.family("bb_lock_wait_seconds_total", "counter", "Time spent waiting for the data locks.");
+    metrics.sample("bb_lock_wait_seconds_total", R"(lock="adverts")", advertsMutex_.waitNanoseconds() / 1e9);
+    metrics.sample("bb_lock_wait_seconds_total", R"(lock="users")", usersMutex_.waitNanoseconds() / 1e9);
+    metrics.family("bb_lock_contentions_total", "counter", "Acquisitions of the data locks that had to wait.");
+    metrics.sample("bb_lock_contentions_total", R"(lock="adverts")", advertsMutex_.contentions());
+    metrics.sample("bb_lock_contentions_total", R"(lock="users")", usersMutex_.contentions());
+}
+
+void BulletinBoardApp::handleEvents(const HttpRequest &request, HttpResponse &response)
+{
+    // EventSource cannot set headers, so the token may also come as ?token=.
+    auto userId = authenticate(request);
+    if (!userId)
+    {
+        if (const auto token = SessionToken::parse(request.getParam("token")))
+        {
+            userId = sessions_.find(*token);
+        }
+    }
+
+    // The server keeps the connection and writes events to it from now on;
+    // anonymous viewers share key 0 and only get events meant for everyone.
+    response.eventStream = static_cast<uint64_t>(userId.value_or(0));
+    response.contentType = "text/event-stream; charset=utf-8";
+    response.setHeader("Cache-Control", "no-cache");
+    response.body = "retry: 3000\n\n";
+}
+
+bool BulletinBoardApp::hasEventStreams() const
+{
+    return server_ && server_->eventStreams() > 0;
+}
+
+void BulletinBoardApp::publishEvent(std::string_view type, std::string_view data, std::optional<int> userId)
+{
+    if (!server_)
+    {
+        return;
+    }
+    // `data` is one line of JSON, so it fits a single data: field.
+    std::string event;
+    event.reserve(type.size() + data.size() + 16);
+    event.append("event: ").append(type).append("\ndata: ").append(data).append("\n\n");
+    server_->publish(std::move(event), userId ? std::optional<uint64_t>(*userId) : std::nullopt);
+}
+
+void BulletinBoardApp::buildAdsJson(int currentUserId, HttpResponse &response) const
+{
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+    const auto snapshot = adsListSnapshot();
+    if (currentUserId == 0)
+    {
+        // Sent straight from the cache; the snapshot lives as long as the response.
+        response.sharedBody = std::shared_ptr<const std::string>(snapshot, &snapshot->body);
+        return;
+    }
+
+    writeViewerAdsList(*snapshot, currentUserId, response.body);
+}
+
+void BulletinBoardApp::writeViewerAdsList(const AdsListSnapshot &snapshot, int currentUserId,
+                                          std::pmr::string &body) const
+{
+    // Splice the viewer's fields into the cached rendering. Only the viewer's
+    // own adverts need a response summary; everything else is a set lookup.
+    auto responded = responses_.adsRespondedBy(currentUserId);
+    std::sort(responded.begin(), responded.end());
+
+    body.reserve(body.size() + snapshot.body.size() + snapshot.entries.size() * 16);
+    JsonWriter json(body);
+    size_t copied = 0;
+    for (const auto &entry : snapshot.entries)
+    {
+        json.raw(std::string_view(snapshot.body).substr(copied, entry.overlayAt - copied));
+        const bool mine = entry.ownerId == currentUserId;
+        const bool hasResponded = std::binary_search(responded.begin(), responded.end(), entry.adId);
+        std::optional<size_t> responsesCount;
+        if (mine)
+        {
+            responsesCount = responses_.summary(entry.adId, currentUserId).count;
+        }
+        writeAdViewerFields(json, mine, hasResponded, responsesCount);
+        copied = entry.end;
+    }
+    json.raw(std::string_view(snapshot.body).substr(copied));
+}
+
+std::shared_ptr<const BulletinBoardApp::AdsListSnapshot> BulletinBoardApp::adsListSnapshot() const
+{
+    // Callers hold advertsMutex_ (shared is enough), so the version is stable.
+    std::lock_guard lock(adsCacheMutex_);
+    if (adsCache_ && adsCache_->version == advertsVersion_)
+    {
+        return adsCache_;
+    }
+
+    auto snapshot = std::make_shared<AdsListSnapshot>();
+    snapshot->version = advertsVersion_;
+    snapshot->entries.reserve(adverts_.size());
+    snapshot->body.reserve(adverts_.size() * kAdJsonSizeHint + 16);
+    JsonWriter json(snapshot->body);
+    json.raw(R"({"ads":[)");
+    adverts_.forEach([&](const Advertisement &ad)
+                     {
+        if (!snapshot->entries.empty())
+        {
+            json.raw(',');
+        }
+        AdsListSnapshot::Entry entry;
+        entry.adId = ad.id;
+        entry.ownerId = ad.ownerId;
+        writeAdFields(json, ad, users_[ad.ownerId - 1].name);
+        entry.overlayAt = snapshot->body.size();
+        writeAdViewerFields(json, false, false, std::nullopt);
+        entry.end = snapshot->body.size();
+        snapshot->entries.push_back(entry); });
+    json.raw("]}");
+
+    adsCache_ = std::move(snapshot);
+    return adsCache_;
+}
+
+void BulletinBoardApp::buildAdsPageJson(int currentUserId, const AdvertQuery &query, std::pmr::string &body) const
+{
+    std::shared_lock advertsLock(advertsMutex_);
+    std::shared_lock usersLock(usersMutex_);
+    const auto page = adverts_.query(query);
+
+    body.reserve(page.adverts.size() * kAdJsonSizeHint + 64);
+    JsonWriter json(body);
+    json.raw(R"({"ads":[)");
+    for (size_t i = 0; i < page.adverts.size(); ++i)
+    {
+        if (i > 0)
+        {
+            json.raw(',');
+        }
+        writeAdJson(json, *page.adverts[i], currentUserId);
+    }
+    json.raw(R"(],"nextCursor":)");
+    if (page.hasMore && !page.adverts.empty())
+    {
+        const auto &last = *page.adverts.back();
+        const bool byPrice = query.sort == AdvertQuery::Sort::PriceAsc || query.sort == AdvertQuery::Sort::PriceDesc;
+        const double key = byPrice ? last.price : static_cast<double>(last.createdAt);
+        json.string(encodeCursor(key, last.id));
+    }
+    else
+    {
+        json.raw("null");
+    }
+    json.raw('}');
+}
+
+void BulletinBoardApp::writeAdJson(JsonWriter<std::pmr::string> &json, const Advertisement &ad, int currentUserId) const
+{
+    const bool isOwner = (ad.ownerId == currentUserId);
+    const auto responses = responses_.summary(ad.id, currentUserId);
+    writeAdFields(json, ad, users_[ad.ownerId - 1].name);
+    writeAdViewerFields(json, isOwner, responses.hasResponded,
+                        isOwner ? std::optional<size_t>(responses.count) : std::nullopt);
+}
+
+void BulletinBoardApp::writeUserJson(JsonWriter<std::pmr::string> &json, const User &user) const
+{
+    json.raw(R"({"id":)").number(user.id);
+    json.raw(R"(,"name":)").string(user.name);
+    json.raw(R"(,"email":)").string(user.email);
+    json.raw('}');
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "changes.hpp"
+#include "compression.hpp"
+#include "http.hpp"
+#include "json.hpp"
+#include "metrics.hpp"
+#include "password.hpp"
+#include "persistence.hpp"
+#include "rate_limit.hpp"
+#include "router.hpp"
+#include "search.hpp"
+#include "server.hpp"
+#include "sessions.hpp"
+#include "static_files.hpp"
+#include "store.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Структура для хранения откликов на объявления
+// Ключ - ID объявления, значение - множество ID пользователей, откликнувшихся на это объявление
+struct Response
+{
+    int userId = 0;
+    int adId = 0;
+    std::time_t respondedAt = 0;
+};
+
+struct AppOptions
+{
+    unsigned hashThreads = 1;
+    // Logins and registrations waiting for a hash beyond this are answered with 503.
+    size_t maxPendingHashes = 1;
+    uint32_t hashIterations = kDefaultPasswordIterations;
+    size_t maxSessions = 100000;
+    std::chrono::seconds sessionTtl = std::chrono::hours(24 * 7);
+    // API responses of at least compressionMinSize bytes go out gzip or
+    // deflate compressed at this zlib level when the client accepts it; 0 disables.
+    int compressionLevel = 1;
+    size_t compressionMinSize = 1024;
+    // Requests per minute a client may make before it is answered with 429;
+    // 0 turns a limit off. Every API request counts per address, sign-ups
+    // and logins once more per address, advert changes per session.
+    unsigned apiRatePerMinute = 6000;
+    unsigned authRatePerMinute = 30;
+    unsigned writeRatePerMinute = 300;
+    // Directory served for paths outside /api; empty for the project's public/.
+    std::filesystem::path staticRoot;
+};
+
+class BulletinBoardApp
+{
+public:
+    explicit BulletinBoardApp(const AppOptions &options);
+    ~BulletinBoardApp();
+    void seedDemoData();
+    // Loads a snapshot file into an empty board. The search index is filled
+    // in the background; searches answer 503 until it is.
+    bool loadSnapshot(const std::filesystem::path &path);
+    bool dumpSnapshot(const std::filesystem::path &path) const;
+    // Restores state from `directory` and journals every change there from
+    // now on. A fresh directory starts from `initialSnapshot` if given and
+    // from the demo data otherwise.
+    bool openDataDirectory(const std::filesystem::path &directory,
+                           const std::optional<std::filesystem::path> &initialSnapshot = std::nullopt);
+    void run(const ServerOptions &options);
+    // Handles one request; what run() hands to the server for every request.
+    void routeRequest(const HttpRequest &request, HttpResponse &response);
+    // The /api/ads list as `currentUserId` sees it (0 for anonymous viewers).
+    void buildAdsJson(int currentUserId, HttpResponse &response) const;
+
+private:
+    // Handles the request and returns the id it is counted under in metrics_.
+    size_t dispatchRequest(const HttpRequest &request, HttpResponse &response);
+    static const Router<BulletinBoardApp> &router();
+    // Metric labels: one per route, then static files, then everything else.
+    static std::vector<std::string> metricRouteLabels();
+    // Router admission: 429 for a client over one of the route's rate limits.
+    static bool admitRequest(BulletinBoardApp &app, const Route<BulletinBoardApp> &route,
+                             const HttpRequest &request, HttpResponse &response);
+    bool serveStatic(const HttpRequest &request, HttpResponse &response) const;
+    // Compresses an API response in place if it is large enough and the client accepts it.
+    void compressResponse(const HttpRequest &request, HttpResponse &response) const;
+    std::optional<int> authenticate(const HttpRequest &request) const;
+
+    // API handlers
+    void handleRegister(const HttpRequest &request, HttpResponse &response);
+    void handleLogin(const HttpRequest &request, HttpResponse &response);
+    void handleLogout(const HttpRequest &request, HttpResponse &response);
+    void handleSession(const HttpRequest &request, HttpResponse &response);
+    void handleAdsList(const HttpRequest &request, HttpResponse &response);
+    void handleAdsChanges(const HttpRequest &request, HttpResponse &response);
+    void handleSearchAds(const HttpRequest &request, HttpResponse &response);
+    void handleCreateAd(const HttpRequest &request, HttpResponse &response);
+    void handleDeleteAd(const HttpRequest &request, HttpResponse &response, int advertId);
+    void handleRespondToAd(const HttpRequest &request, HttpResponse &response, int advertId);
+    void handleMyResponses(const HttpRequest &request, HttpResponse &response);
+    void handleAdResponders(const HttpRequest &request, HttpResponse &response, int advertId);
+    void handleMetrics(const HttpRequest &request, HttpResponse &response);
+    void handleEvents(const HttpRequest &request, HttpResponse &response);
+
+    // Helpers
+    // Full advert list as seen by an anonymous viewer, rendered once per
+    // advert set. `overlayAt` is where the viewer fields of an advert start.
+    struct AdsListSnapshot
+    {
+        struct Entry
+        {
+            int adId = 0;
+            int ownerId = 0;
+            size_t overlayAt = 0;
+            size_t end = 0;
+        };
+
+        uint64_t version = 0;
+        std::string body;
+        std::vector<Entry> entries;
+    };
+
+    std::shared_ptr<const AdsListSnapshot> adsListSnapshot() const;
+    // The snapshot with `currentUserId`'s fields spliced in; the caller holds the locks.
+    void writeViewerAdsList(const AdsListSnapshot &snapshot, int currentUserId, std::pmr::string &body) const;
+    void buildAdsPageJson(int currentUserId, const AdvertQuery &query, std::pmr::string &body) const;
+    void writeAdJson(JsonWriter<std::pmr::string> &json, const Advertisement &ad, int currentUserId) const;
+    void writeUserJson(JsonWriter<std::pmr::string> &json, const User &user) const;
+    PersistedState captureState() const;
+    void loadState(PersistedState state);
+    void indexInBackground(std::vector<int> advertIds);
+    // Called with advertsMutex_ held exclusively after adverts were added or removed.
+    void advertsChanged();
+    // With advertsMutex_ held exclusively: drops the advert, its search entry
+    // and its responses, and records the removal.
+    void removeAdvert(int advertId);
+    // Whether anyone listens on /api/events, so events are worth rendering.
+    bool hasEventStreams() const;
+    // Sends an event to every /api/events stream, or only to `userId`'s.
+    void publishEvent(std::string_view type, std::string_view data, std::optional<int> userId = std::nullopt);
+    // Waits until the journal holds record `sequence`. If it never will, the
+    // response becomes a 500 and the caller has to undo its change in memory:
+    // the client is told it failed, and the board must not show otherwise.
+    bool awaitDurable(uint64_t sequence, HttpResponse &response) const;
+
+    // Data. Lock order: advertsMutex_, then usersMutex_, then store shards.
+    mutable MeasuredSharedMutex usersMutex_;
+    std::vector<User> users_;
+    std::unordered_map<std::string, int> emailToUserId_;
+    int nextUserId_ = 1;
+
+    mutable MeasuredSharedMutex advertsMutex_;
+    AdvertStore adverts_;
+    int nextAdvertId_ = 1;
+    // Bumped under advertsMutex_ whenever an advert is added or removed
+    uint64_t advertsVersion_ = 0;
+    // adverts_.size() as of the last change, readable without the lock
+    std::atomic<size_t> advertCount_{0};
+    // Updated under advertsMutex_ so it never holds adverts that are gone
+    SearchIndex searchIndex_;
+    // Every create, delete and response after the change it records, for
+    // /api/ads/changes. Responses are recorded under a shared advertsMutex_.
+    ChangeLog changes_;
+    // False while indexer_ is still adding loaded adverts to searchIndex_
+    std::atomic<bool> searchReady_{true};
+    std::atomic<bool> stopIndexing_{false};
+    std::thread indexer_;
+
+    mutable std::mutex adsCacheMutex_;
+    mutable std::shared_ptr<const AdsListSnapshot> adsCache_;
+
+    SessionStore sessions_;
+    // Хранение откликов: ключ - ID объявления, значение - множество ID пользователей
+    ResponseStore responses_;
+
+    StaticFileCache staticFiles_;
+    PasswordHasher passwordHasher_;
+    // Logins for unknown emails are checked against this, so they cost as
+    // much as a wrong password.
+    const std::string dummyPasswordHash_;
+
+    RequestMetrics metrics_;
+    // Set while run() serves, for the connection gauges and event streams.
+    HttpServer *server_ = nullptr;
+
+    const int compressionLevel_;
+    const size_t compressionMinSize_;
+    // The last shared body compressed (the anonymous /api/ads list), reused
+    // for as long as that body is still the one being sent.
+    struct CompressedBody
+    {
+        std::weak_ptr<const std::string> source;
+        ContentCoding coding = ContentCoding::Identity;
+        std::shared_ptr<const std::string> body;
+    };
+    mutable std::mutex compressedMutex_;
+    mutable CompressedBody compressedShared_;
+
+    RateLimiter rateLimiter_;
+
+    // Null when running without a data directory. Declared last so it stops
+    // (and takes its last snapshot of the members above) before they go away.
+    std::unique_ptr<WriteAheadLog> wal_;
+};
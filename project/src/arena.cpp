@@ -0,0 +1,86 @@
+#include "arena.hpp"
+
+#include <new>
+
+RequestArena::~RequestArena()
+{
+    reset();
+    for (char *block : blocks_)
+    {
+        ::operator delete(block);
+    }
+}
+
+void RequestArena::reset()
+{
+    for (const auto &large : large_)
+    {
+        ::operator delete(large.data, large.size, std::align_val_t(large.alignment));
+    }
+    large_.clear();
+
+    while (blocks_.size() > kRetainedBlocks)
+    {
+        ::operator delete(blocks_.back());
+        blocks_.pop_back();
+    }
+    block_ = 0;
+    offset_ = blocks_.empty() ? kBlockSize : 0;
+}
+
+void RequestArena::release()
+{
+    reset();
+    for (char *block : blocks_)
+    {
+        ::operator delete(block);
+    }
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+    large_.shrink_to_fit();
+    offset_ = kBlockSize;
+}
+
+void *RequestArena::do_allocate(size_t bytes, size_t alignment)
+{
+    if (isLarge(bytes, alignment))
+    {
+        void *data = ::operator new(bytes, std::align_val_t(alignment));
+        large_.push_back({data, bytes, alignment});
+        return data;
+    }
+
+    size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (start + bytes > kBlockSize)
+    {
+        // Move on to the next block; earlier exchanges may have left one.
+        const size_t next = blocks_.empty() ? 0 : block_ + 1;
+        if (next == blocks_.size())
+        {
+            blocks_.push_back(static_cast<char *>(::operator new(kBlockSize)));
+        }
+        block_ = next;
+        start = 0;
+    }
+    offset_ = start + bytes;
+    return blocks_[block_] + start;
+}
+
+void RequestArena::do_deallocate(void *data, size_t bytes, size_t alignment)
+{
+    if (!isLarge(bytes, alignment))
+    {
+        return; // reclaimed by reset()
+    }
+    // Usually the most recent one, e.g. the previous capacity of a growing body.
+    for (size_t i = large_.size(); i-- > 0;)
+    {
+        if (large_[i].data == data)
+        {
+            ::operator delete(data, bytes, std::align_val_t(alignment));
+            large_[i] = large_.back();
+            large_.pop_back();
+            return;
+        }
+    }
+}
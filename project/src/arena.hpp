@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator behind one request/response exchange on a connection:
+// parsed headers and parameters, the response body and its serialized head.
+// reset() rewinds it for the next exchange but keeps its blocks, so a
+// connection in steady state does not go to the global heap at all.
+//
+// Not thread-safe. A connection is only ever worked on by one thread at a
+// time, and everything allocated from the arena must be destroyed before
+// reset() is called.
+class RequestArena : public std::pmr::memory_resource
+{
+public:
+    RequestArena() = default;
+    ~RequestArena() override;
+
+    RequestArena(const RequestArena &) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+
+    void reset();
+    // Like reset(), but hands every block back, for a connection that will
+    // sit idle for long (an event stream).
+    void release();
+
+private:
+    static constexpr size_t kBlockSize = 8 * 1024;
+    // Bigger allocations (typically a long response body) get memory of their
+    // own, returned as soon as they are deallocated.
+    static constexpr size_t kLargeSize = kBlockSize / 4;
+    // reset() releases blocks beyond these, so one unusual request does not
+    // pin memory on an otherwise idle connection.
+    static constexpr size_t kRetainedBlocks = 4;
+
+    struct Large
+    {
+        void *data;
+        size_t size;
+        size_t alignment;
+    };
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *data, size_t bytes, size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    static bool isLarge(size_t bytes, size_t alignment)
+    {
+        return bytes >= kLargeSize || alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+
+    std::vector<char *> blocks_;
+    size_t block_ = 0;
+    size_t offset_ = kBlockSize;
+    std::vector<Large> large_;
+};
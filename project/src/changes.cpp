@@ -0,0 +1,48 @@
+#include "changes.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    uint64_t startingSequence()
+    {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+    }
+}
+
+ChangeLog::ChangeLog(size_t capacity)
+    : ring_(std::max<size_t>(1, capacity)), sequence_(startingSequence())
+{
+}
+
+uint64_t ChangeLog::record(int adId, Kind kind)
+{
+    std::lock_guard lock(mutex_);
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed) + 1;
+    ring_[next_] = {sequence, adId, kind};
+    next_ = (next_ + 1) % ring_.size();
+    count_ = std::min(count_ + 1, ring_.size());
+    sequence_.store(sequence, std::memory_order_release);
+    return sequence;
+}
+
+std::optional<std::vector<ChangeLog::Change>> ChangeLog::since(uint64_t since, uint64_t &current) const
+{
+    std::lock_guard lock(mutex_);
+    current = sequence_.load(std::memory_order_relaxed);
+    // Everything after `since` must still be in the ring.
+    if (since > current || current - since > count_)
+    {
+        return std::nullopt;
+    }
+    const auto wanted = static_cast<size_t>(current - since);
+    std::vector<Change> changes;
+    changes.reserve(wanted);
+    for (size_t i = wanted; i > 0; --i)
+    {
+        changes.push_back(ring_[(next_ + ring_.size() - i) % ring_.size()]);
+    }
+    return changes;
+}
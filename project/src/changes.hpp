@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// The most recent advert changes in a ring, numbered by a sequence that only
+// grows, so clients can ask for what happened after the last number they saw.
+//
+// The sequence starts from the wall clock at startup (in microseconds). A
+// client still holding a number from before a restart is then behind the
+// whole ring and told to resync, instead of getting a delta of another run.
+// The numbers stay far below 2^53, so JavaScript clients keep them exact.
+class ChangeLog
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Added,
+        Updated,
+        Removed,
+    };
+
+    struct Change
+    {
+        uint64_t sequence = 0;
+        int adId = 0;
+        Kind kind = Kind::Updated;
+    };
+
+    explicit ChangeLog(size_t capacity);
+
+    // Returns the sequence number given to the change.
+    uint64_t record(int adId, Kind kind);
+
+    // Number of the latest change.
+    [[nodiscard]] uint64_t sequence() const { return sequence_.load(std::memory_order_acquire); }
+
+    // Changes after `since`, oldest first, with `current` set to the number
+    // of the last one. Nullopt if some of them have already been overwritten
+    // or `since` was never handed out.
+    std::optional<std::vector<Change>> since(uint64_t since, uint64_t &current) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<Change> ring_;
+    // Slot of the next change; the ring is full once `count_` reaches its size.
+    size_t next_ = 0;
+    size_t count_ = 0;
+    std::atomic<uint64_t> sequence_;
+};
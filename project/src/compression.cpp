@@ -0,0 +1,108 @@
+#include "compression.hpp"
+
+#include "http.hpp"
+
+#include <zlib.h>
+
+namespace
+{
+    // A deflate stream kept by one thread for one coding.
+    class ThreadDeflater
+    {
+    public:
+        explicit ThreadDeflater(int windowBits) : windowBits_(windowBits) {}
+        ~ThreadDeflater()
+        {
+            if (level_ != 0)
+            {
+                deflateEnd(&stream_);
+            }
+        }
+
+        ThreadDeflater(const ThreadDeflater &) = delete;
+        ThreadDeflater &operator=(const ThreadDeflater &) = delete;
+
+        // A fresh stream at `level`; only a change of level allocates again.
+        z_stream *prepare(int level)
+        {
+            if (level_ == level)
+            {
+                return deflateReset(&stream_) == Z_OK ? &stream_ : nullptr;
+            }
+            if (level_ != 0)
+            {
+                deflateEnd(&stream_);
+                stream_ = {};
+                level_ = 0;
+            }
+            if (deflateInit2(&stream_, level, Z_DEFLATED, windowBits_, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                return nullptr;
+            }
+            level_ = level;
+            return &stream_;
+        }
+
+    private:
+        int windowBits_;
+        int level_ = 0;
+        z_stream stream_{};
+    };
+}
+
+ContentCoding negotiateCoding(std::string_view acceptEncoding)
+{
+    if (acceptsEncoding(acceptEncoding, "gzip"))
+    {
+        return ContentCoding::Gzip;
+    }
+    if (acceptsEncoding(acceptEncoding, "deflate"))
+    {
+        return ContentCoding::Deflate;
+    }
+    return ContentCoding::Identity;
+}
+
+std::string_view codingName(ContentCoding coding)
+{
+    switch (coding)
+    {
+    case ContentCoding::Gzip:
+        return "gzip";
+    case ContentCoding::Deflate:
+        return "deflate";
+    default:
+        return {};
+    }
+}
+
+size_t compressedBound(size_t inputSize)
+{
+    // compressBound() covers the 6 bytes of the zlib wrapper; the gzip one is 18.
+    return compressBound(static_cast<uLong>(inputSize)) + 12;
+}
+
+size_t compressBody(std::string_view input, ContentCoding coding, int level, char *output, size_t capacity)
+{
+    // 15 window bits selects the zlib wrapper HTTP calls "deflate"; +16 selects gzip.
+    static thread_local ThreadDeflater gzip(15 + 16);
+    static thread_local ThreadDeflater deflater(15);
+    if (coding == ContentCoding::Identity || level < 1 || level > 9)
+    {
+        return 0;
+    }
+    z_stream *stream = (coding == ContentCoding::Gzip ? gzip : deflater).prepare(level);
+    if (!stream)
+    {
+        return 0;
+    }
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream->avail_in = static_cast<uInt>(input.size());
+    stream->next_out = reinterpret_cast<Bytef *>(output);
+    stream->avail_out = static_cast<uInt>(capacity);
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(stream->total_out);
+}
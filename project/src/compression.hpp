@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+enum class ContentCoding
+{
+    Identity,
+    Gzip,
+    Deflate,
+};
+
+// The coding to answer an Accept-Encoding value with: gzip, then deflate,
+// otherwise identity.
+ContentCoding negotiateCoding(std::string_view acceptEncoding);
+
+// Content-Encoding value of a coding; empty for identity.
+std::string_view codingName(ContentCoding coding);
+
+// Upper bound of what compressBody writes for `inputSize` bytes.
+size_t compressedBound(size_t inputSize);
+
+// Compresses `input` into `output` at zlib `level` (1-9) and returns the
+// compressed size, or 0 if it does not fit or zlib fails. Each thread keeps
+// one zlib stream per coding and only resets it between calls, so the
+// deflate state is allocated once per thread rather than once per response.
+size_t compressBody(std::string_view input, ContentCoding coding, int level, char *output, size_t capacity);
+
+// The same into a string, which ends up holding just the compressed bytes.
+template <typename String>
+bool compressBody(std::string_view input, ContentCoding coding, int level, String &output)
+{
+    output.resize(compressedBound(input.size()));
+    const size_t size = compressBody(input, coding, level, output.data(), output.size());
+    output.resize(size);
+    return size != 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+// Reads a command-line value. The whole text has to be one non-negative
+// number no larger than `max` (and finite, for floating point); otherwise
+// `value` is left alone and the result is false, so the caller can print
+// its usage instead of dying on an exception.
+template <typename T>
+bool parseFlagValue(std::string_view text, T &value, T max = std::numeric_limits<T>::max())
+{
+    static_assert(std::is_arithmetic_v<T>, "flag values are numbers");
+    T parsed{};
+    const char *end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, parsed);
+    if (text.empty() || result.ec != std::errc() || result.ptr != end || parsed < T{} || parsed > max)
+    {
+        return false;
+    }
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if (!std::isfinite(parsed))
+        {
+            return false;
+        }
+    }
+    value = parsed;
+    return true;
+}
+
+// A duration given as a count of its own units ("--duration 10" for seconds).
+template <typename Rep, typename Period>
+bool parseFlagValue(std::string_view text, std::chrono::duration<Rep, Period> &value)
+{
+    Rep count{};
+    if (!parseFlagValue(text, count))
+    {
+        return false;
+    }
+    value = std::chrono::duration<Rep, Period>(count);
+    return true;
+}
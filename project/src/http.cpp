@@ -0,0 +1,415 @@
+#include "http.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+
+std::string toLower(std::string_view value)
+{
+    std::string result(value);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char ch)
+                   { return static_cast<char>(std::tolower(ch)); });
+    return result;
+}
+
+std::string_view trim(std::string_view value)
+{
+    const auto begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+    const auto end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs)
+{
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace
+{
+    int hexValue(char ch)
+    {
+        if (ch >= '0' && ch <= '9')
+            return ch - '0';
+        if (ch >= 'a' && ch <= 'f')
+            return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F')
+            return ch - 'A' + 10;
+        return -1;
+    }
+
+    std::string_view trimView(std::string_view value)
+    {
+        const auto begin = value.find_first_not_of(" \t");
+        if (begin == std::string_view::npos)
+        {
+            return {};
+        }
+        const auto end = value.find_last_not_of(" \t");
+        return value.substr(begin, end - begin + 1);
+    }
+}
+
+std::pmr::string urlDecode(std::string_view value, std::pmr::memory_resource *resource)
+{
+    std::pmr::string result(resource);
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (value[i] == '%' && i + 2 < value.size())
+        {
+            const int high = hexValue(value[i + 1]);
+            const int low = hexValue(value[i + 2]);
+            result.push_back(static_cast<char>(high < 0 || low < 0 ? 0 : high * 16 + low));
+            i += 2;
+        }
+        else if (value[i] == '+')
+        {
+            result.push_back(' ');
+        }
+        else
+        {
+            result.push_back(value[i]);
+        }
+    }
+    return result;
+}
+
+HttpParams parseParams(std::string_view data, std::pmr::memory_resource *resource)
+{
+    HttpParams result(resource);
+    size_t start = 0;
+    while (start < data.size())
+    {
+        const auto amp = data.find('&', start);
+        const auto token = data.substr(start, amp == std::string_view::npos ? std::string_view::npos : amp - start);
+        const auto eq = token.find('=');
+        if (eq != std::string_view::npos)
+        {
+            auto key = urlDecode(token.substr(0, eq), resource);
+            auto value = urlDecode(token.substr(eq + 1), resource);
+            result[std::move(key)] = std::move(value);
+        }
+        else if (!token.empty())
+        {
+            result[urlDecode(token, resource)].clear();
+        }
+        if (amp == std::string_view::npos)
+        {
+            break;
+        }
+        start = amp + 1;
+    }
+    return result;
+}
+
+ParseStatus HttpParser::parse(const std::string &buffer, HttpRequest &request)
+{
+    while (state_ != State::Body)
+    {
+        const auto newline = buffer.find('\n', scanPos_);
+        if (newline == std::string::npos)
+        {
+            scanPos_ = buffer.size();
+            return ParseStatus::Incomplete;
+        }
+        scanPos_ = newline + 1;
+
+        size_t lineEnd = newline;
+        if (lineEnd > lineStart_ && buffer[lineEnd - 1] == '\r')
+        {
+            --lineEnd;
+        }
+        const size_t lineOffset = lineStart_;
+        const std::string_view line(buffer.data() + lineOffset, lineEnd - lineOffset);
+        lineStart_ = scanPos_;
+
+        if (state_ == State::RequestLine)
+        {
+            // Stray CRLFs between pipelined requests are allowed (RFC 7230, 3.5).
+            if (line.empty())
+            {
+                continue;
+            }
+            if (!parseRequestLine(line, lineOffset))
+            {
+                return ParseStatus::Invalid;
+            }
+            state_ = State::Headers;
+        }
+        else if (line.empty())
+        {
+            bodyStart_ = scanPos_;
+            // Checked before the two are added, so a huge length cannot wrap
+            // consumed() around to something that looks already buffered.
+            if (contentLength_ > kMaxRequestBytes || bodyStart_ > kMaxRequestBytes - contentLength_)
+            {
+                return ParseStatus::TooLarge;
+            }
+            state_ = State::Body;
+        }
+        else if (!parseHeaderLine(line, lineOffset))
+        {
+            return ParseStatus::Invalid;
+        }
+    }
+
+    if (buffer.size() < consumed())
+    {
+        return ParseStatus::Incomplete;
+    }
+    materialize(buffer, request);
+    return ParseStatus::Complete;
+}
+
+void HttpParser::reset()
+{
+    state_ = State::RequestLine;
+    scanPos_ = 0;
+    lineStart_ = 0;
+    bodyStart_ = 0;
+    contentLength_ = 0;
+    hasContentLength_ = false;
+    headers_.clear();
+}
+
+bool HttpParser::parseRequestLine(std::string_view line, size_t lineOffset)
+{
+    const auto firstSpace = line.find(' ');
+    if (firstSpace == std::string_view::npos || firstSpace == 0)
+    {
+        return false;
+    }
+    const auto targetBegin = line.find_first_not_of(' ', firstSpace);
+    if (targetBegin == std::string_view::npos)
+    {
+        return false;
+    }
+    auto targetEnd = line.find(' ', targetBegin);
+    if (targetEnd == std::string_view::npos)
+    {
+        targetEnd = line.size();
+    }
+
+    method_ = {lineOffset, firstSpace};
+    target_ = {lineOffset + targetBegin, targetEnd - targetBegin};
+    const auto version = trimView(line.substr(targetEnd));
+    version_ = {version.empty() ? lineOffset : static_cast<size_t>(version.data() - line.data()) + lineOffset,
+                version.size()};
+    return true;
+}
+
+bool HttpParser::parseHeaderLine(std::string_view line, size_t lineOffset)
+{
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos)
+    {
+        return true; // ignored, as before
+    }
+    const auto name = line.substr(0, colon);
+    const auto value = trimView(line.substr(colon + 1));
+    const auto valueOffset = value.empty() ? lineOffset : static_cast<size_t>(value.data() - line.data()) + lineOffset;
+
+    if (equalsIgnoreCase(name, "content-length"))
+    {
+        // A second Content-Length, even an equal one, is refused: a proxy in
+        // front may have picked the other and would see a different request.
+        size_t length = 0;
+        const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (hasContentLength_ || ec != std::errc() || end != value.data() + value.size())
+        {
+            return false;
+        }
+        contentLength_ = length;
+        hasContentLength_ = true;
+    }
+    else if (equalsIgnoreCase(name, "transfer-encoding"))
+    {
+        // Chunked bodies are not supported; refusing them keeps a persistent
+        // connection from misreading the body as the next request.
+        return false;
+    }
+
+    headers_.push_back({{lineOffset, name.size()}, {valueOffset, value.size()}});
+    return true;
+}
+
+void HttpParser::materialize(const std::string &buffer, HttpRequest &request) const
+{
+    const auto view = [data = buffer.data()](Span span)
+    {
+        return std::string_view(data + span.offset, span.length);
+    };
+
+    request = HttpRequest(request.resource());
+    request.method = view(method_);
+    request.rawTarget = view(target_);
+    request.version = view(version_);
+    request.headers.reserve(headers_.size());
+    for (const auto &[name, value] : headers_)
+    {
+        request.headers.emplace_back(view(name), view(value));
+    }
+    request.body = std::string_view(buffer.data() + bodyStart_, contentLength_);
+
+    const auto question = request.rawTarget.find('?');
+    request.path = request.rawTarget.substr(0, question);
+    if (question != std::string_view::npos)
+    {
+        request.query = parseParams(request.rawTarget.substr(question + 1), request.resource());
+    }
+    if (request.path.empty())
+    {
+        request.path = "/";
+    }
+
+    const auto contentType = request.getHeader("content-type");
+    if (contentType.find("application/x-www-form-urlencoded") != std::string_view::npos)
+    {
+        request.form = parseParams(request.body, request.resource());
+    }
+}
+
+bool wantsKeepAlive(const HttpRequest &request)
+{
+    const auto connection = toLower(request.getHeader("connection"));
+    if (connection.find("close") != std::string::npos)
+    {
+        return false;
+    }
+    if (request.version == "HTTP/1.0")
+    {
+        return connection.find("keep-alive") != std::string::npos;
+    }
+    return true;
+}
+
+FileBody::~FileBody()
+{
+    ::close(fd);
+}
+
+bool acceptsEncoding(std::string_view acceptEncoding, std::string_view coding)
+{
+    std::optional<bool> wildcard;
+    while (!acceptEncoding.empty())
+    {
+        const auto comma = acceptEncoding.find(',');
+        auto item = acceptEncoding.substr(0, comma);
+        acceptEncoding = comma == std::string_view::npos ? std::string_view{} : acceptEncoding.substr(comma + 1);
+
+        bool allowed = true;
+        if (const auto semicolon = item.find(';'); semicolon != std::string_view::npos)
+        {
+            // Only "q=0" (any number of zero decimals) refuses a coding.
+            const auto params = trim(item.substr(semicolon + 1));
+            if (params.size() >= 3 && (params[0] == 'q' || params[0] == 'Q') && params[1] == '=')
+            {
+                allowed = params.find_first_not_of("0.", 2) != std::string::npos;
+            }
+            item = item.substr(0, semicolon);
+        }
+        const auto name = trim(item);
+        if (equalsIgnoreCase(name, coding))
+        {
+            return allowed;
+        }
+        if (name == "*")
+        {
+            wildcard = allowed;
+        }
+    }
+    return wildcard.value_or(false);
+}
+
+const char *statusText(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 201:
+        return "Created";
+    case 204:
+        return "No Content";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 403:
+        return "Forbidden";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 409:
+        return "Conflict";
+    case 413:
+        return "Payload Too Large";
+    case 429:
+        return "Too Many Requests";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "OK";
+    }
+}
+
+std::pmr::string serializeHead(const HttpResponse &response, bool keepAlive)
+{
+    std::pmr::string head(response.body.get_allocator());
+    head.reserve(128 + response.contentType.size() + response.headers.size() * 48);
+    char number[24];
+    const auto appendNumber = [&](auto value)
+    {
+        head.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+    };
+    const auto appendHeader = [&](std::string_view name, std::string_view value)
+    {
+        head.append(name).append(": ").append(value).append("\r\n");
+    };
+
+    head.append("HTTP/1.1 ");
+    appendNumber(response.status);
+    head.push_back(' ');
+    head.append(statusText(response.status)).append("\r\n");
+    // A 304 describes the cached representation, so it carries neither.
+    if (response.status != 304)
+    {
+        appendHeader("Content-Type", response.contentType);
+    }
+    // An event stream has no length; it ends when the connection does.
+    if (response.status != 304 && !response.eventStream)
+    {
+        head.append("Content-Length: ");
+        appendNumber(response.bodySize());
+        head.append("\r\n");
+    }
+    appendHeader("Connection", keepAlive ? "keep-alive" : "close");
+    for (const auto &[key, value] : response.headers)
+    {
+        appendHeader(key, value);
+    }
+    head.append("\r\n");
+    return head;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs);
+
+using HttpParams = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
+// Views point into the connection's receive buffer and stay valid until the
+// response to this request has been queued. Containers allocate from the
+// resource the request was created with (the connection's arena in the server).
+struct HttpRequest
+{
+    explicit HttpRequest(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : headers(resource), query(resource), form(resource)
+    {
+    }
+
+    std::string_view method;
+    std::string_view rawTarget;
+    std::string_view version;
+    std::string_view path;
+    std::pmr::vector<std::pair<std::string_view, std::string_view>> headers;
+    HttpParams query;
+    HttpParams form;
+    std::string_view body;
+    // IPv4 address of the client in host byte order; 0 outside the server.
+    uint32_t remoteAddress = 0;
+
+    [[nodiscard]] std::pmr::memory_resource *resource() const { return headers.get_allocator().resource(); }
+
+    [[nodiscard]] std::string_view getHeader(std::string_view key) const
+    {
+        for (const auto &[name, value] : headers)
+        {
+            if (equalsIgnoreCase(name, key))
+            {
+                return value;
+            }
+        }
+        return {};
+    }
+
+    // Form fields take precedence over query parameters. The view lives as
+    // long as the request.
+    [[nodiscard]] std::string_view getParam(std::string_view key) const
+    {
+        if (form.empty() && query.empty())
+        {
+            return {};
+        }
+        const std::pmr::string name(key, resource());
+        if (auto it = form.find(name); it != form.end())
+        {
+            return it->second;
+        }
+        if (auto it = query.find(name); it != query.end())
+        {
+            return it->second;
+        }
+        return {};
+    }
+};
+
+// A response body sent straight from a file descriptor with sendfile(2). The
+// descriptor is closed with the last reference; its contents must not change
+// while a response still points at it.
+struct FileBody
+{
+    FileBody(int fd, size_t size) : fd(fd), size(size) {}
+    ~FileBody();
+
+    FileBody(const FileBody &) = delete;
+    FileBody &operator=(const FileBody &) = delete;
+
+    int fd;
+    size_t size;
+};
+
+// Like HttpRequest, allocates from the resource it was created with.
+struct HttpResponse
+{
+    explicit HttpResponse(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : contentType("application/json; charset=utf-8", resource), body(resource), headers(resource)
+    {
+    }
+
+    int status = 200;
+    std::pmr::string contentType;
+    std::pmr::string body;
+    // Alternatives to `body` for bytes owned elsewhere, sent without a copy.
+    // At most one of body, sharedBody and file is set.
+    std::shared_ptr<const std::string> sharedBody;
+    std::shared_ptr<const FileBody> file;
+    std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> headers;
+    // Set to keep the connection open as an event stream once the head and
+    // `body` are out; it then gets what HttpServer::publish sends to every
+    // stream or to this subscriber key.
+    std::optional<uint64_t> eventStream;
+
+    void setHeader(std::string_view key, std::string_view value)
+    {
+        headers.emplace_back(key, value);
+    }
+
+    [[nodiscard]] size_t bodySize() const
+    {
+        return file ? file->size : sharedBody ? sharedBody->size() : body.size();
+    }
+};
+
+// Largest request, head and body together, a connection will buffer.
+constexpr size_t kMaxRequestBytes = 1 << 20;
+
+enum class ParseStatus
+{
+    Incomplete,
+    Complete,
+    Invalid,
+    // Content-Length puts the end of the request past kMaxRequestBytes.
+    TooLarge,
+};
+
+std::string toLower(std::string_view value);
+std::string_view trim(std::string_view value);
+std::pmr::string urlDecode(std::string_view value,
+                           std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+HttpParams parseParams(std::string_view data, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+// Incremental request parser over a connection buffer that only grows at the
+// back between calls. Progress is kept as offsets, so a reallocation of the
+// buffer does not matter and no byte is scanned twice across partial reads.
+class HttpParser
+{
+public:
+    // On Complete, `request` views bytes [0, consumed()) of `buffer`.
+    ParseStatus parse(const std::string &buffer, HttpRequest &request);
+
+    // Size of the completed request; anything after it is the next pipelined one.
+    [[nodiscard]] size_t consumed() const { return bodyStart_ + contentLength_; }
+
+    // Prepares for the next request once the caller dropped consumed() bytes.
+    void reset();
+
+private:
+    struct Span
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    enum class State
+    {
+        RequestLine,
+        Headers,
+        Body,
+    };
+
+    bool parseRequestLine(std::string_view line, size_t lineOffset);
+    bool parseHeaderLine(std::string_view line, size_t lineOffset);
+    void materialize(const std::string &buffer, HttpRequest &request) const;
+
+    State state_ = State::RequestLine;
+    size_t scanPos_ = 0;
+    size_t lineStart_ = 0;
+    size_t bodyStart_ = 0;
+    size_t contentLength_ = 0;
+    bool hasContentLength_ = false;
+    Span method_;
+    Span target_;
+    Span version_;
+    std::vector<std::pair<Span, Span>> headers_;
+};
+
+// HTTP/1.1 connections persist unless the client sends "Connection: close";
+// HTTP/1.0 ones only when it asks for keep-alive.
+bool wantsKeepAlive(const HttpRequest &request);
+
+// Whether an Accept-Encoding header value allows `coding` ("gzip", "br", ...),
+// honouring "q=0" and the "*" wildcard.
+bool acceptsEncoding(std::string_view acceptEncoding, std::string_view coding);
+
+const char *statusText(int status);
+// Status line and headers, allocated like the response; the body is written
+// separately.
+std::pmr::string serializeHead(const HttpResponse &response, bool keepAlive);
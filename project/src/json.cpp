@@ -0,0 +1,154 @@
+#include "json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 0: copy as is, 'u': \u00XX, anything else: the character after '\'.
+    // Backspace and form feed stay \u0008 and \u000c, as the server has
+    // always written them, rather than the shorter \b and \f.
+    constexpr std::array<char, 256> makeEscapeTable()
+    {
+        std::array<char, 256> table{};
+        for (int ch = 0; ch < 0x20; ++ch)
+        {
+            table[ch] = 'u';
+        }
+        table['"'] = '"';
+        table['\\'] = '\\';
+        table['\n'] = 'n';
+        table['\r'] = 'r';
+        table['\t'] = 't';
+        return table;
+    }
+
+    constexpr auto kEscapeTable = makeEscapeTable();
+
+    // Length of the prefix of [data, data + size) that needs no escaping.
+    size_t cleanRunLength(const char *data, size_t size)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        // Signed compare: bytes >= 0x80 are negative, so shift into range first.
+        const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i controlLimit = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            const __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmplt_epi8(_mm_xor_si128(chunk, bias), controlLimit));
+            if (const int mask = _mm_movemask_epi8(special); mask != 0)
+            {
+                return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+            }
+        }
+#endif
+        while (i < size && kEscapeTable[static_cast<unsigned char>(data[i])] == 0)
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    template <typename String>
+    void appendEscaped(String &out, std::string_view value)
+    {
+        static constexpr char kHex[] = "0123456789abcdef";
+        const char *data = value.data();
+        size_t remaining = value.size();
+        while (remaining > 0)
+        {
+            const size_t run = cleanRunLength(data, remaining);
+            out.append(data, run);
+            data += run;
+            remaining -= run;
+            if (remaining == 0)
+            {
+                break;
+            }
+
+            const auto ch = static_cast<unsigned char>(*data);
+            const char escape = kEscapeTable[ch];
+            if (escape == 'u')
+            {
+                const char sequence[] = {'\\', 'u', '0', '0', kHex[ch >> 4], kHex[ch & 0xF]};
+                out.append(sequence, sizeof(sequence));
+            }
+            else
+            {
+                const char sequence[] = {'\\', escape};
+                out.append(sequence, sizeof(sequence));
+            }
+            ++data;
+            --remaining;
+        }
+    }
+}
+
+void appendJsonEscaped(std::string &out, std::string_view value)
+{
+    appendEscaped(out, value);
+}
+
+void appendJsonEscaped(std::pmr::string &out, std::string_view value)
+{
+    appendEscaped(out, value);
+}
+
+template <typename String>
+JsonWriter<String> &JsonWriter<String>::number(long long value)
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, result.ptr);
+    return *this;
+}
+
+template <typename String>
+JsonWriter<String> &JsonWriter<String>::number(unsigned long long value)
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, result.ptr);
+    return *this;
+}
+
+template <typename String>
+JsonWriter<String> &JsonWriter<String>::fixed(double value, int precision)
+{
+    if (!std::isfinite(value))
+    {
+        out_.append("null");
+        return *this;
+    }
+    char buffer[64];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, precision);
+    if (result.ec == std::errc{})
+    {
+        out_.append(buffer, result.ptr);
+        return *this;
+    }
+    // Past about 1e60 the digits do not fit on the stack: a sign, up to 309
+    // integer digits, the point and the fraction (six if none is given).
+    const size_t fraction = static_cast<size_t>(std::max(precision, 6));
+    std::string wide(std::numeric_limits<double>::max_exponent10 + 3 + fraction, '\0');
+    const auto wideResult =
+        std::to_chars(wide.data(), wide.data() + wide.size(), value, std::chars_format::fixed, precision);
+    out_.append(wide.data(), wideResult.ptr);
+    return *this;
+}
+
+template class JsonWriter<std::string>;
+template class JsonWriter<std::pmr::string>;
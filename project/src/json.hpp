@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// Appends `value` to `out` as the body of a JSON string (no quotes). Runs of
+// characters that need no escaping are copied in bulk.
+void appendJsonEscaped(std::string &out, std::string_view value);
+void appendJsonEscaped(std::pmr::string &out, std::string_view value);
+
+// Streams JSON into a caller-owned buffer, either a plain string or one in a
+// request arena. Structure is written with raw() fragments, values with the
+// typed appenders; nothing is validated.
+template <typename String>
+class JsonWriter
+{
+public:
+    explicit JsonWriter(String &out) : out_(out) {}
+
+    JsonWriter &raw(std::string_view fragment)
+    {
+        out_.append(fragment);
+        return *this;
+    }
+
+    JsonWriter &raw(char ch)
+    {
+        out_.push_back(ch);
+        return *this;
+    }
+
+    JsonWriter &string(std::string_view value)
+    {
+        out_.push_back('"');
+        appendJsonEscaped(out_, value);
+        out_.push_back('"');
+        return *this;
+    }
+
+    JsonWriter &boolean(bool value)
+    {
+        return raw(value ? std::string_view("true") : std::string_view("false"));
+    }
+
+    JsonWriter &number(long long value);
+    JsonWriter &number(unsigned long long value);
+    JsonWriter &number(int value) { return number(static_cast<long long>(value)); }
+    JsonWriter &number(unsigned long value) { return number(static_cast<unsigned long long>(value)); }
+    JsonWriter &number(long value) { return number(static_cast<long long>(value)); }
+    // Fixed-point, like printf("%.*f"); NaN and infinities, which JSON
+    // cannot express, are written as null.
+    JsonWriter &fixed(double value, int precision);
+
+    [[nodiscard]] String &buffer() { return out_; }
+
+private:
+    String &out_;
+};
+
+extern template class JsonWriter<std::string>;
+extern template class JsonWriter<std::pmr::string>;
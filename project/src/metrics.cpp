@@ -0,0 +1,293 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+    std::atomic<uint64_t> nextMetricsId{1};
+
+    // Upper bounds of the exported histogram buckets, in microseconds.
+    constexpr uint64_t kExportedBounds[] = {100,    250,    500,     1000,    2500,    5000,    10000,   25000,
+                                            50000,  100000, 250000,  500000,  1000000, 2500000, 5000000, 10000000};
+
+    constexpr const char *kExportedBoundLabels[] = {"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+                                                    "0.01",   "0.025",   "0.05",   "0.1",   "0.25",   "0.5",
+                                                    "1",      "2.5",     "5",      "10"};
+    static_assert(std::size(kExportedBoundLabels) == std::size(kExportedBounds));
+
+    constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+    constexpr const char *kQuantileLabels[] = {"0.5", "0.9", "0.99", "0.999"};
+
+    // Owner-only counters: a load and a store are enough and avoid a locked add.
+    void bump(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void appendNumber(std::pmr::string &out, uint64_t value)
+    {
+        char buffer[24];
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+    }
+
+    // Plain decimals ("0.00025", not "2.5e-04"), as Prometheus itself writes bucket bounds.
+    void appendNumber(std::pmr::string &out, double value)
+    {
+        char buffer[64];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed);
+        if (result.ec != std::errc{})
+        {
+            out.append("+Inf");
+            return;
+        }
+        out.append(buffer, result.ptr);
+    }
+
+    // Label value with the escapes the exposition format requires.
+    std::string quoteLabel(std::string_view value)
+    {
+        std::string quoted = "\"";
+        for (char ch : value)
+        {
+            if (ch == '\\' || ch == '"')
+            {
+                quoted.push_back('\\');
+                quoted.push_back(ch);
+            }
+            else if (ch == '\n')
+            {
+                quoted.append("\\n");
+            }
+            else
+            {
+                quoted.push_back(ch);
+            }
+        }
+        quoted.push_back('"');
+        return quoted;
+    }
+}
+
+void MetricsWriter::family(std::string_view name, std::string_view type, std::string_view help)
+{
+    out_.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out_.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void MetricsWriter::sample(std::string_view name, std::string_view labels, uint64_t value)
+{
+    begin(name, labels);
+    appendNumber(out_, value);
+    out_.push_back('\n');
+}
+
+void MetricsWriter::sample(std::string_view name, std::string_view labels, double value)
+{
+    begin(name, labels);
+    appendNumber(out_, value);
+    out_.push_back('\n');
+}
+
+void MetricsWriter::begin(std::string_view name, std::string_view labels)
+{
+    out_.append(name);
+    if (!labels.empty())
+    {
+        out_.append("{").append(labels).append("}");
+    }
+    out_.push_back(' ');
+}
+
+RequestMetrics::RequestMetrics(std::vector<std::string> routes)
+    : id_(nextMetricsId.fetch_add(1, std::memory_order_relaxed))
+{
+    labels_.reserve(routes.size());
+    for (const auto &route : routes)
+    {
+        labels_.push_back("route=" + quoteLabel(route));
+    }
+}
+
+RequestMetrics::~RequestMetrics()
+{
+    for (Shard *shard = shards_.load(); shard != nullptr;)
+    {
+        delete std::exchange(shard, shard->next);
+    }
+}
+
+size_t RequestMetrics::bucketFor(uint64_t micros)
+{
+    if (micros < kLinearBuckets)
+    {
+        return static_cast<size_t>(micros);
+    }
+    const unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(micros));
+    if (exponent >= kMaxExponent)
+    {
+        return kBuckets - 1;
+    }
+    const auto subBucket = (micros >> (exponent - kSubBucketBits)) & ((uint64_t(1) << kSubBucketBits) - 1);
+    return kLinearBuckets + ((exponent - 4) << kSubBucketBits) + static_cast<size_t>(subBucket);
+}
+
+uint64_t RequestMetrics::bucketLowerBound(size_t bucket)
+{
+    if (bucket < kLinearBuckets)
+    {
+        return bucket;
+    }
+    const size_t index = bucket - kLinearBuckets;
+    const unsigned exponent = 4 + static_cast<unsigned>(index >> kSubBucketBits);
+    const uint64_t subBucket = index & ((size_t(1) << kSubBucketBits) - 1);
+    return ((uint64_t(1) << kSubBucketBits) + subBucket) << (exponent - kSubBucketBits);
+}
+
+uint64_t RequestMetrics::bucketUpperBound(size_t bucket)
+{
+    return bucket + 1 < kBuckets ? bucketLowerBound(bucket + 1) : UINT64_MAX;
+}
+
+RequestMetrics::Shard &RequestMetrics::localShard()
+{
+    struct Cached
+    {
+        uint64_t owner = 0;
+        Shard *shard = nullptr;
+    };
+    static thread_local Cached cached;
+    if (cached.owner != id_)
+    {
+        auto *shard = new Shard(labels_.size() * kSlotsPerRoute);
+        shard->next = shards_.load(std::memory_order_relaxed);
+        while (!shards_.compare_exchange_weak(shard->next, shard, std::memory_order_release,
+                                              std::memory_order_relaxed))
+        {
+        }
+        cached = {id_, shard};
+    }
+    return *cached.shard;
+}
+
+void RequestMetrics::record(size_t route, int status, std::chrono::nanoseconds elapsed)
+{
+    if (route >= labels_.size())
+    {
+        return;
+    }
+    const auto micros = static_cast<uint64_t>(std::max<int64_t>(0, elapsed.count() / 1000));
+    std::atomic<uint64_t> *slots = localShard().counters.get() + route * kSlotsPerRoute;
+    bump(slots[bucketFor(micros)], 1);
+    bump(slots[kSumSlot], micros);
+    const int statusClass = status / 100 - 1;
+    if (statusClass >= 0 && statusClass < static_cast<int>(kStatusClasses))
+    {
+        bump(slots[kStatusSlot + static_cast<size_t>(statusClass)], 1);
+    }
+}
+
+std::vector<uint64_t> RequestMetrics::collect() const
+{
+    std::vector<uint64_t> totals(labels_.size() * kSlotsPerRoute);
+    for (const Shard *shard = shards_.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            totals[i] += shard->counters[i].load(std::memory_order_relaxed);
+        }
+    }
+    return totals;
+}
+
+void RequestMetrics::write(MetricsWriter &writer) const
+{
+    const auto totals = collect();
+    std::string labels;
+
+    writer.family("bb_http_request_duration_seconds", "histogram", "Time spent handling requests, by route.");
+    for (size_t route = 0; route < labels_.size(); ++route)
+    {
+        const uint64_t *slots = totals.data() + route * kSlotsPerRoute;
+        // A bucket counts towards a bound once every value it can hold is within it.
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (size_t i = 0; i < std::size(kExportedBounds); ++i)
+        {
+            for (; bucket < kBuckets && bucketUpperBound(bucket) - 1 <= kExportedBounds[i]; ++bucket)
+            {
+                cumulative += slots[bucket];
+            }
+            labels.assign(labels_[route]).append(",le=\"").append(kExportedBoundLabels[i]).append("\"");
+            writer.sample("bb_http_request_duration_seconds_bucket", labels, cumulative);
+        }
+        for (; bucket < kBuckets; ++bucket)
+        {
+            cumulative += slots[bucket];
+        }
+        labels.assign(labels_[route]).append(",le=\"+Inf\"");
+        writer.sample("bb_http_request_duration_seconds_bucket", labels, cumulative);
+        writer.sample("bb_http_request_duration_seconds_sum", labels_[route], static_cast<double>(slots[kSumSlot]) / 1e6);
+        writer.sample("bb_http_request_duration_seconds_count", labels_[route], cumulative);
+    }
+
+    writer.family("bb_http_request_duration_quantile_seconds", "gauge",
+                  "Request latency quantiles since start, from the full-resolution histogram.");
+    for (size_t route = 0; route < labels_.size(); ++route)
+    {
+        const uint64_t *slots = totals.data() + route * kSlotsPerRoute;
+        uint64_t count = 0;
+        for (size_t bucket = 0; bucket < kBuckets; ++bucket)
+        {
+            count += slots[bucket];
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < std::size(kQuantiles); ++i)
+        {
+            // Nearest rank: the smallest value with at least this share of samples at or below it.
+            const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(kQuantiles[i] * static_cast<double>(count))));
+            uint64_t seen = 0;
+            size_t bucket = 0;
+            while (bucket + 1 < kBuckets && seen + slots[bucket] < rank)
+            {
+                seen += slots[bucket++];
+            }
+            // Midpoint of the bucket, which is within 6.25% of any value in it.
+            const uint64_t lower = bucketLowerBound(bucket);
+            const uint64_t upper = bucket + 1 < kBuckets ? bucketUpperBound(bucket) : lower + 1;
+            labels.assign(labels_[route]).append(",quantile=\"").append(kQuantileLabels[i]).append("\"");
+            writer.sample("bb_http_request_duration_quantile_seconds", labels,
+                          static_cast<double>(lower + upper) / 2e6);
+        }
+    }
+
+    writer.family("bb_http_responses_total", "counter", "Responses sent, by route and status class.");
+    static constexpr const char *kClassLabels[kStatusClasses] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+    for (size_t route = 0; route < labels_.size(); ++route)
+    {
+        const uint64_t *slots = totals.data() + route * kSlotsPerRoute;
+        for (size_t statusClass = 0; statusClass < kStatusClasses; ++statusClass)
+        {
+            if (slots[kStatusSlot + statusClass] == 0)
+            {
+                continue;
+            }
+            labels.assign(labels_[route]).append(",code=\"").append(kClassLabels[statusClass]).append("\"");
+            writer.sample("bb_http_responses_total", labels, slots[kStatusSlot + statusClass]);
+        }
+    }
+}
+
+void MeasuredSharedMutex::recordWait(std::chrono::steady_clock::time_point started)
+{
+    const auto waited = std::chrono::steady_clock::now() - started;
+    waitNanoseconds_.fetch_add(static_cast<uint64_t>(std::chrono::nanoseconds(waited).count()),
+                               std::memory_order_relaxed);
+    contentions_.fetch_add(1, std::memory_order_relaxed);
+}
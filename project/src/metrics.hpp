@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Prometheus text exposition format (version 0.0.4), appended to `out`.
+class MetricsWriter
+{
+public:
+    explicit MetricsWriter(std::pmr::string &out) : out_(out) {}
+
+    void family(std::string_view name, std::string_view type, std::string_view help);
+    // `labels` goes between the braces as is, e.g. R"(lock="users")"; may be empty.
+    void sample(std::string_view name, std::string_view labels, uint64_t value);
+    void sample(std::string_view name, std::string_view labels, double value);
+
+private:
+    void begin(std::string_view name, std::string_view labels);
+
+    std::pmr::string &out_;
+};
+
+// Request counts, status classes and latency histograms per route. Every
+// thread records into a shard of its own with plain relaxed stores, so
+// recording never contends; write() sums the shards without stopping anyone.
+//
+// Latencies go into HDR-style log-linear buckets over microseconds: exact
+// below 16 us, then eight buckets per power of two (at most 12.5% apart),
+// up to about 18 minutes.
+class RequestMetrics
+{
+public:
+    explicit RequestMetrics(std::vector<std::string> routes);
+    ~RequestMetrics();
+
+    RequestMetrics(const RequestMetrics &) = delete;
+    RequestMetrics &operator=(const RequestMetrics &) = delete;
+
+    void record(size_t route, int status, std::chrono::nanoseconds elapsed);
+    void write(MetricsWriter &writer) const;
+
+private:
+    static constexpr unsigned kLinearBuckets = 16;
+    static constexpr unsigned kSubBucketBits = 3;
+    static constexpr unsigned kMaxExponent = 30;
+    static constexpr size_t kBuckets =
+        kLinearBuckets + (kMaxExponent - 4) * (size_t(1) << kSubBucketBits);
+    static constexpr size_t kStatusClasses = 5;
+    // Per route: the buckets, the sum in microseconds, one count per status class.
+    static constexpr size_t kSumSlot = kBuckets;
+    static constexpr size_t kStatusSlot = kBuckets + 1;
+    static constexpr size_t kSlotsPerRoute = kStatusSlot + kStatusClasses;
+
+    struct Shard
+    {
+        explicit Shard(size_t slots) : counters(new std::atomic<uint64_t>[slots]()) {}
+
+        std::unique_ptr<std::atomic<uint64_t>[]> counters;
+        Shard *next = nullptr;
+    };
+
+    static size_t bucketFor(uint64_t micros);
+    static uint64_t bucketLowerBound(size_t bucket);
+    static uint64_t bucketUpperBound(size_t bucket);
+
+    Shard &localShard();
+    // Sums of every slot over all shards, route by route.
+    [[nodiscard]] std::vector<uint64_t> collect() const;
+
+    const uint64_t id_;
+    std::vector<std::string> labels_;
+    // Shards are pushed by their threads and only freed with the metrics.
+    std::atomic<Shard *> shards_{nullptr};
+};
+
+// A std::shared_mutex that keeps count of how long callers waited for it.
+// Uncontended acquisitions cost a try_lock; only a failed one reads the clock.
+class MeasuredSharedMutex
+{
+public:
+    void lock()
+    {
+        if (!mutex_.try_lock())
+        {
+            const auto started = std::chrono::steady_clock::now();
+            mutex_.lock();
+            recordWait(started);
+        }
+    }
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+
+    void lock_shared()
+    {
+        if (!mutex_.try_lock_shared())
+        {
+            const auto started = std::chrono::steady_clock::now();
+            mutex_.lock_shared();
+            recordWait(started);
+        }
+    }
+    bool try_lock_shared() { return mutex_.try_lock_shared(); }
+    void unlock_shared() { mutex_.unlock_shared(); }
+
+    [[nodiscard]] uint64_t waitNanoseconds() const { return waitNanoseconds_.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t contentions() const { return contentions_.load(std::memory_order_relaxed); }
+
+private:
+    void recordWait(std::chrono::steady_clock::time_point started);
+
+    std::shared_mutex mutex_;
+    std::atomic<uint64_t> waitNanoseconds_{0};
+    std::atomic<uint64_t> contentions_{0};
+};
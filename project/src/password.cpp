@@ -0,0 +1,313 @@
+#include "password.hpp"
+
+#include "random.hpp"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <future>
+#include <memory>
+
+namespace
+{
+    constexpr std::string_view kScheme = "pbkdf2-sha256";
+    constexpr size_t kSaltSize = 16;
+    constexpr size_t kKeySize = 32;
+
+    // FIPS 180-4 SHA-256, just enough for HMAC: callers feed whole blocks and
+    // pad the final one themselves.
+    struct Sha256State
+    {
+        std::array<uint32_t, 8> h{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    };
+
+    constexpr uint32_t kRoundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    constexpr uint32_t rotr(uint32_t value, int bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    void compress(Sha256State &state, const uint8_t *block)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                   (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; ++i)
+        {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state.h[0], b = state.h[1], c = state.h[2], d = state.h[3];
+        uint32_t e = state.h[4], f = state.h[5], g = state.h[6], h = state.h[7];
+        for (int i = 0; i < 64; ++i)
+        {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                                kRoundConstants[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state.h[0] += a;
+        state.h[1] += b;
+        state.h[2] += c;
+        state.h[3] += d;
+        state.h[4] += e;
+        state.h[5] += f;
+        state.h[6] += g;
+        state.h[7] += h;
+    }
+
+    // Hashes `length` more bytes on top of `prefixBytes` already compressed into `state`.
+    std::array<uint8_t, 32> finish(Sha256State state, uint64_t prefixBytes, const uint8_t *data, size_t length)
+    {
+        const uint64_t totalBits = (prefixBytes + length) * 8;
+        for (; length >= 64; data += 64, length -= 64)
+        {
+            compress(state, data);
+        }
+        uint8_t tail[128] = {};
+        std::memcpy(tail, data, length);
+        tail[length] = 0x80;
+        const size_t tailSize = length + 9 <= 64 ? 64 : 128;
+        for (int i = 0; i < 8; ++i)
+        {
+            tail[tailSize - 1 - i] = static_cast<uint8_t>(totalBits >> (8 * i));
+        }
+        compress(state, tail);
+        if (tailSize == 128)
+        {
+            compress(state, tail + 64);
+        }
+
+        std::array<uint8_t, 32> digest;
+        for (int i = 0; i < 8; ++i)
+        {
+            digest[i * 4] = static_cast<uint8_t>(state.h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(state.h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(state.h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(state.h[i]);
+        }
+        return digest;
+    }
+
+    // HMAC-SHA256 with the padded key blocks compressed once up front, so
+    // each PBKDF2 iteration costs two compressions instead of four.
+    class Hmac
+    {
+    public:
+        explicit Hmac(std::string_view key)
+        {
+            uint8_t block[64] = {};
+            if (key.size() > sizeof(block))
+            {
+                const auto digest = finish({}, 0, reinterpret_cast<const uint8_t *>(key.data()), key.size());
+                std::memcpy(block, digest.data(), digest.size());
+            }
+            else
+            {
+                std::memcpy(block, key.data(), key.size());
+            }
+            uint8_t pad[64];
+            for (int i = 0; i < 64; ++i)
+            {
+                pad[i] = block[i] ^ 0x36;
+            }
+            compress(inner_, pad);
+            for (int i = 0; i < 64; ++i)
+            {
+                pad[i] = block[i] ^ 0x5c;
+            }
+            compress(outer_, pad);
+        }
+
+        std::array<uint8_t, 32> operator()(const uint8_t *data, size_t length) const
+        {
+            const auto innerDigest = finish(inner_, 64, data, length);
+            return finish(outer_, 64, innerDigest.data(), innerDigest.size());
+        }
+
+    private:
+        Sha256State inner_;
+        Sha256State outer_;
+    };
+
+    // PBKDF2 (RFC 8018) for a single 32-byte block, which is all we derive.
+    std::array<uint8_t, kKeySize> pbkdf2(std::string_view password, std::string_view salt, uint32_t iterations)
+    {
+        const Hmac hmac(password);
+        std::string first(salt);
+        first.append("\0\0\0\1", 4);
+        auto u = hmac(reinterpret_cast<const uint8_t *>(first.data()), first.size());
+        auto key = u;
+        for (uint32_t i = 1; i < iterations; ++i)
+        {
+            u = hmac(u.data(), u.size());
+            for (size_t j = 0; j < key.size(); ++j)
+            {
+                key[j] ^= u[j];
+            }
+        }
+        return key;
+    }
+
+    std::string toHex(const uint8_t *data, size_t size)
+    {
+        static constexpr char kHex[] = "0123456789abcdef";
+        std::string hex(size * 2, '\0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            hex[i * 2] = kHex[data[i] >> 4];
+            hex[i * 2 + 1] = kHex[data[i] & 0xF];
+        }
+        return hex;
+    }
+
+    std::optional<std::string> fromHex(std::string_view hex)
+    {
+        if (hex.size() % 2 != 0)
+        {
+            return std::nullopt;
+        }
+        std::string bytes(hex.size() / 2, '\0');
+        for (size_t i = 0; i < bytes.size(); ++i)
+        {
+            uint8_t value = 0;
+            const auto [end, ec] = std::from_chars(hex.data() + i * 2, hex.data() + i * 2 + 2, value, 16);
+            if (ec != std::errc() || end != hex.data() + i * 2 + 2)
+            {
+                return std::nullopt;
+            }
+            bytes[i] = static_cast<char>(value);
+        }
+        return bytes;
+    }
+
+    // Compares without an early exit so timing does not reveal the matching prefix.
+    bool constantTimeEquals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        unsigned char diff = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+
+    // Splits off the text before the next '$'.
+    std::string_view nextField(std::string_view &rest)
+    {
+        const auto dollar = rest.find('$');
+        const auto field = rest.substr(0, dollar);
+        rest = dollar == std::string_view::npos ? std::string_view{} : rest.substr(dollar + 1);
+        return field;
+    }
+}
+
+std::string hashPassword(std::string_view password, uint32_t iterations)
+{
+    uint8_t salt[kSaltSize];
+    secureRandomBytes(salt, sizeof(salt));
+    const std::string_view saltView(reinterpret_cast<const char *>(salt), sizeof(salt));
+    const auto key = pbkdf2(password, saltView, iterations);
+
+    std::string stored(kScheme);
+    stored.push_back('$');
+    stored.append(std::to_string(iterations));
+    stored.push_back('$');
+    stored.append(toHex(salt, sizeof(salt)));
+    stored.push_back('$');
+    stored.append(toHex(key.data(), key.size()));
+    return stored;
+}
+
+bool verifyPassword(std::string_view password, std::string_view stored)
+{
+    std::string_view rest = stored;
+    if (nextField(rest) != kScheme)
+    {
+        return false;
+    }
+    const auto iterationsText = nextField(rest);
+    const auto salt = fromHex(nextField(rest));
+    const auto expected = fromHex(nextField(rest));
+    uint32_t iterations = 0;
+    const auto [end, ec] = std::from_chars(iterationsText.data(), iterationsText.data() + iterationsText.size(), iterations);
+    if (ec != std::errc() || end != iterationsText.data() + iterationsText.size() || iterations == 0 || !salt ||
+        !expected)
+    {
+        return false;
+    }
+    const auto key = pbkdf2(password, *salt, iterations);
+    return constantTimeEquals(std::string_view(reinterpret_cast<const char *>(key.data()), key.size()), *expected);
+}
+
+PasswordHasher::PasswordHasher(unsigned threads, size_t maxPending, uint32_t iterations)
+    : iterations_(iterations), maxPending_(std::max<size_t>(1, maxPending)), pool_(threads, maxPending_)
+{
+}
+
+template <typename T, typename Fn>
+std::optional<T> PasswordHasher::run(Fn &&fn)
+{
+    if (pending_.fetch_add(1) >= maxPending_)
+    {
+        pending_.fetch_sub(1);
+        return std::nullopt;
+    }
+    auto promise = std::make_shared<std::promise<T>>();
+    auto result = promise->get_future();
+    const bool posted = pool_.tryPost([promise, fn = std::forward<Fn>(fn)]()
+                                      {
+        // Hashing is background work: let request workers preempt it.
+        static thread_local const bool lowered = setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), 10) == 0;
+        (void)lowered;
+        promise->set_value(fn()); });
+    std::optional<T> value;
+    if (posted)
+    {
+        value = result.get();
+    }
+    pending_.fetch_sub(1);
+    return value;
+}
+
+std::optional<std::string> PasswordHasher::hash(std::string password)
+{
+    return run<std::string>([password = std::move(password), iterations = iterations_]()
+                            { return hashPassword(password, iterations); });
+}
+
+std::optional<bool> PasswordHasher::verify(std::string password, std::string stored)
+{
+    return run<bool>([password = std::move(password), stored = std::move(stored)]()
+                     { return verifyPassword(password, stored); });
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "server.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Tuned so a hash takes tens of milliseconds on a current server core.
+constexpr uint32_t kDefaultPasswordIterations = 100000;
+
+// PBKDF2-HMAC-SHA256 with a random per-user salt. Hashes are stored as
+//
+//   pbkdf2-sha256$<iterations>$<salt hex>$<key hex>
+//
+// so the cost can be raised later without invalidating existing users.
+// Anything else never verifies, the unsalted std::hash values of older
+// builds included: those accounts have to register again.
+std::string hashPassword(std::string_view password, uint32_t iterations);
+bool verifyPassword(std::string_view password, std::string_view stored);
+
+// Runs the deliberately slow hashing on its own small pool of low-priority
+// threads. Request workers wait for the result, so at most `maxPending`
+// hashes are accepted at once; that keeps a burst of logins from tying up
+// every worker while readers queue behind them.
+class PasswordHasher
+{
+public:
+    PasswordHasher(unsigned threads, size_t maxPending, uint32_t iterations);
+
+    // Empty when the pool is saturated; the caller should answer 503.
+    [[nodiscard]] std::optional<std::string> hash(std::string password);
+    [[nodiscard]] std::optional<bool> verify(std::string password, std::string stored);
+
+    [[nodiscard]] uint32_t iterations() const { return iterations_; }
+
+private:
+    template <typename T, typename Fn>
+    std::optional<T> run(Fn &&fn);
+
+    uint32_t iterations_;
+    size_t maxPending_;
+    std::atomic<size_t> pending_{0};
+    WorkerPool pool_;
+};
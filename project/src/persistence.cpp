@@ -0,0 +1,709 @@
+#include "persistence.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+    // Records are framed as [u32 payload length][u32 crc32 of payload][payload],
+    // the payload being a type byte followed by fixed-width fields in native
+    // byte order and length-prefixed strings.
+    enum class RecordType : uint8_t
+    {
+        UserRegistered = 1,
+        AdvertCreated = 2,
+        AdvertDeleted = 3,
+        ResponseAdded = 4,
+        SessionOpened = 5,
+        SessionClosed = 6,
+        SnapshotHeader = 100,
+        SnapshotEnd = 101,
+    };
+
+    constexpr size_t kFrameHeaderSize = 8;
+    constexpr uint32_t kSnapshotMagic = 0x42425331; // "BBS1"
+    constexpr std::string_view kSegmentPrefix = "wal-";
+    constexpr std::string_view kSegmentSuffix = ".log";
+    constexpr const char *kSnapshotName = "snapshot.bin";
+
+    class RecordWriter
+    {
+    public:
+        RecordWriter(std::string &out, RecordType type) : out_(out), start_(out.size())
+        {
+            out_.append(kFrameHeaderSize, '\0');
+            u8(static_cast<uint8_t>(type));
+        }
+
+        RecordWriter &u8(uint8_t value) { return raw(&value, sizeof(value)); }
+        RecordWriter &i32(int32_t value) { return raw(&value, sizeof(value)); }
+        RecordWriter &u32(uint32_t value) { return raw(&value, sizeof(value)); }
+        RecordWriter &i64(int64_t value) { return raw(&value, sizeof(value)); }
+        RecordWriter &u64(uint64_t value) { return raw(&value, sizeof(value)); }
+        RecordWriter &f64(double value) { return raw(&value, sizeof(value)); }
+
+        RecordWriter &str(std::string_view value)
+        {
+            u32(static_cast<uint32_t>(value.size()));
+            out_.append(value);
+            return *this;
+        }
+
+        void finish()
+        {
+            const auto payload = std::string_view(out_).substr(start_ + kFrameHeaderSize);
+            const auto length = static_cast<uint32_t>(payload.size());
+            const auto crc = static_cast<uint32_t>(
+                crc32(0, reinterpret_cast<const Bytef *>(payload.data()), static_cast<uInt>(payload.size())));
+            std::memcpy(out_.data() + start_, &length, sizeof(length));
+            std::memcpy(out_.data() + start_ + sizeof(length), &crc, sizeof(crc));
+        }
+
+    private:
+        RecordWriter &raw(const void *data, size_t size)
+        {
+            out_.append(static_cast<const char *>(data), size);
+            return *this;
+        }
+
+        std::string &out_;
+        size_t start_;
+    };
+
+    // Bounds-checked reads from one payload; any overrun marks it bad.
+    class RecordReader
+    {
+    public:
+        explicit RecordReader(std::string_view payload) : data_(payload) {}
+
+        uint8_t u8() { return read<uint8_t>(); }
+        int32_t i32() { return read<int32_t>(); }
+        uint32_t u32() { return read<uint32_t>(); }
+        int64_t i64() { return read<int64_t>(); }
+        uint64_t u64() { return read<uint64_t>(); }
+        double f64() { return read<double>(); }
+
+        std::string str()
+        {
+            const auto size = u32();
+            if (!ok_ || size > data_.size())
+            {
+                ok_ = false;
+                return {};
+            }
+            std::string value(data_.substr(0, size));
+            data_.remove_prefix(size);
+            return value;
+        }
+
+        [[nodiscard]] bool ok() const { return ok_ && data_.empty(); }
+
+    private:
+        template <typename T>
+        T read()
+        {
+            T value{};
+            if (data_.size() < sizeof(T))
+            {
+                ok_ = false;
+                return value;
+            }
+            std::memcpy(&value, data_.data(), sizeof(T));
+            data_.remove_prefix(sizeof(T));
+            return value;
+        }
+
+        std::string_view data_;
+        bool ok_ = true;
+    };
+
+    // Splits a buffer into verified payloads; stops at the first torn or
+    // corrupt frame and reports how many bytes were good.
+    template <typename Fn>
+    size_t forEachFrame(std::string_view data, Fn &&fn)
+    {
+        size_t offset = 0;
+        while (data.size() - offset >= kFrameHeaderSize)
+        {
+            uint32_t length = 0;
+            uint32_t crc = 0;
+            std::memcpy(&length, data.data() + offset, sizeof(length));
+            std::memcpy(&crc, data.data() + offset + sizeof(length), sizeof(crc));
+            if (length > data.size() - offset - kFrameHeaderSize)
+            {
+                break;
+            }
+            const auto payload = data.substr(offset + kFrameHeaderSize, length);
+            if (crc32(0, reinterpret_cast<const Bytef *>(payload.data()), static_cast<uInt>(payload.size())) != crc ||
+                !fn(payload))
+            {
+                break;
+            }
+            offset += kFrameHeaderSize + length;
+        }
+        return offset;
+    }
+
+    // Applies records in log order. Every operation is idempotent.
+    class StateBuilder
+    {
+    public:
+        bool apply(std::string_view payload)
+        {
+            RecordReader reader(payload);
+            switch (static_cast<RecordType>(reader.u8()))
+            {
+            case RecordType::UserRegistered:
+            {
+                User user;
+                user.id = reader.i32();
+                user.name = reader.str();
+                user.email = reader.str();
+                user.passwordHash = reader.str();
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                nextUserId_ = std::max(nextUserId_, user.id + 1);
+                users_[user.id] = std::move(user);
+                return true;
+            }
+            case RecordType::AdvertCreated:
+            {
+                Advertisement advert;
+                advert.id = reader.i32();
+                advert.ownerId = reader.i32();
+                advert.title = reader.str();
+                advert.description = reader.str();
+                advert.price = reader.f64();
+                advert.createdAt = static_cast<std::time_t>(reader.i64());
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                nextAdvertId_ = std::max(nextAdvertId_, advert.id + 1);
+                adverts_[advert.id] = std::move(advert);
+                return true;
+            }
+            case RecordType::AdvertDeleted:
+            {
+                const int advertId = reader.i32();
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                adverts_.erase(advertId);
+                responses_.erase(responses_.lower_bound({advertId, INT32_MIN}),
+                                 responses_.upper_bound({advertId, INT32_MAX}));
+                return true;
+            }
+            case RecordType::ResponseAdded:
+            {
+                const int advertId = reader.i32();
+                const int userId = reader.i32();
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                responses_.emplace(advertId, userId);
+                return true;
+            }
+            case RecordType::SessionOpened:
+            {
+                auto token = reader.str();
+                const int userId = reader.i32();
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                sessions_[std::move(token)] = userId;
+                return true;
+            }
+            case RecordType::SessionClosed:
+            {
+                const auto token = reader.str();
+                if (!reader.ok())
+                {
+                    return false;
+                }
+                sessions_.erase(token);
+                return true;
+            }
+            case RecordType::SnapshotHeader:
+            {
+                if (reader.u32() != kSnapshotMagic)
+                {
+                    return false;
+                }
+                firstSegment_ = reader.u64();
+                nextUserId_ = std::max(nextUserId_, reader.i32());
+                nextAdvertId_ = std::max(nextAdvertId_, reader.i32());
+                return reader.ok();
+            }
+            case RecordType::SnapshotEnd:
+                complete_ = true;
+                return true;
+            }
+            return false;
+        }
+
+        PersistedState finish()
+        {
+            PersistedState state;
+            state.nextUserId = nextUserId_;
+            state.nextAdvertId = nextAdvertId_;
+            for (auto &[id, user] : users_)
+            {
+                state.users.push_back(std::move(user));
+            }
+            // Ids are handed out in creation order.
+            for (auto &[id, advert] : adverts_)
+            {
+                state.adverts.push_back(std::move(advert));
+            }
+            state.responses.assign(responses_.begin(), responses_.end());
+            for (auto &[token, userId] : sessions_)
+            {
+                state.sessions.emplace_back(token, userId);
+            }
+            return state;
+        }
+
+        [[nodiscard]] uint64_t firstSegment() const { return firstSegment_; }
+        [[nodiscard]] bool complete() const { return complete_; }
+
+    private:
+        std::map<int, User> users_;
+        std::map<int, Advertisement> adverts_;
+        std::set<std::pair<int, int>> responses_;
+        std::unordered_map<std::string, int> sessions_;
+        int nextUserId_ = 1;
+        int nextAdvertId_ = 1;
+        uint64_t firstSegment_ = 1;
+        bool complete_ = false;
+    };
+
+    std::string segmentName(uint64_t segment)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "wal-%012llu.log", static_cast<unsigned long long>(segment));
+        return buffer;
+    }
+
+    std::optional<uint64_t> parseSegmentName(const std::string &name)
+    {
+        if (name.size() <= kSegmentPrefix.size() + kSegmentSuffix.size() ||
+            name.compare(0, kSegmentPrefix.size(), kSegmentPrefix) != 0 ||
+            name.compare(name.size() - kSegmentSuffix.size(), kSegmentSuffix.size(), kSegmentSuffix) != 0)
+        {
+            return std::nullopt;
+        }
+        uint64_t segment = 0;
+        const char *begin = name.data() + kSegmentPrefix.size();
+        const char *end = name.data() + name.size() - kSegmentSuffix.size();
+        const auto [ptr, ec] = std::from_chars(begin, end, segment);
+        if (ec != std::errc() || ptr != end)
+        {
+            return std::nullopt;
+        }
+        return segment;
+    }
+
+    bool readFile(const std::filesystem::path &path, std::string &content)
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (!input)
+        {
+            return false;
+        }
+        content.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        return !input.bad();
+    }
+
+    bool writeAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            const ssize_t written = ::write(fd, data.data(), data.size());
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+        return true;
+    }
+
+    bool syncDirectory(const std::filesystem::path &directory)
+    {
+        const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        const bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    int openSegment(const std::filesystem::path &directory, uint64_t segment)
+    {
+        const auto path = directory / segmentName(segment);
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        // Make the new file itself durable, not just what gets written to it;
+        // records synced into a segment the directory lost would be gone.
+        if (fd >= 0 && !syncDirectory(directory))
+        {
+            const int error = errno;
+            ::close(fd);
+            errno = error;
+            return -1;
+        }
+        return fd;
+    }
+}
+
+WriteAheadLog::WriteAheadLog(std::filesystem::path directory, size_t snapshotEveryRecords)
+    : directory_(std::move(directory)), snapshotEveryRecords_(std::max<size_t>(1, snapshotEveryRecords))
+{
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    flushCv_.notify_all();
+    compactCv_.notify_all();
+    if (compactor_.joinable())
+    {
+        compactor_.join();
+    }
+    // The flusher drains what is pending before it exits.
+    if (flusher_.joinable())
+    {
+        flusher_.join();
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool WriteAheadLog::recover(PersistedState &state)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec)
+    {
+        std::cerr << "wal: cannot create " << directory_ << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    StateBuilder builder;
+    std::string content;
+    const auto snapshotPath = directory_ / kSnapshotName;
+    if (std::filesystem::exists(snapshotPath) && readFile(snapshotPath, content))
+    {
+        forEachFrame(content, [&](std::string_view payload)
+                     { return builder.apply(payload); });
+        if (!builder.complete())
+        {
+            std::cerr << "wal: " << snapshotPath << " is incomplete" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<uint64_t> segments;
+    for (const auto &entry : std::filesystem::directory_iterator(directory_, ec))
+    {
+        if (auto segment = parseSegmentName(entry.path().filename().string()))
+        {
+            segments.push_back(*segment);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+
+    segment_ = builder.firstSegment() - 1;
+    for (const uint64_t segment : segments)
+    {
+        const auto path = directory_ / segmentName(segment);
+        segment_ = std::max(segment_, segment);
+        if (segment < builder.firstSegment())
+        {
+            // Already covered; left over from a crash right after a snapshot.
+            std::filesystem::remove(path, ec);
+            continue;
+        }
+        if (!readFile(path, content))
+        {
+            std::cerr << "wal: cannot read " << path << std::endl;
+            return false;
+        }
+        const size_t good = forEachFrame(content, [&](std::string_view payload)
+                                         { return builder.apply(payload); });
+        if (good < content.size())
+        {
+            // A torn final write; nothing after it was acknowledged.
+            std::cerr << "wal: ignoring " << content.size() - good << " trailing bytes of " << path << std::endl;
+        }
+    }
+
+    state = builder.finish();
+    return true;
+}
+
+bool WriteAheadLog::open(Capture capture)
+{
+    capture_ = std::move(capture);
+    {
+        std::lock_guard fileLock(fileMutex_);
+        fd_ = openSegment(directory_, ++segment_);
+        if (fd_ < 0)
+        {
+            std::perror("wal: open");
+            return false;
+        }
+    }
+    flusher_ = std::thread(&WriteAheadLog::flushLoop, this);
+    compactor_ = std::thread(&WriteAheadLog::compactLoop, this);
+    return true;
+}
+
+uint64_t WriteAheadLog::userRegistered(const User &user)
+{
+    std::string record;
+    RecordWriter(record, RecordType::UserRegistered).i32(user.id).str(user.name).str(user.email).str(user.passwordHash).finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::advertCreated(const Advertisement &advert)
+{
+    std::string record;
+    RecordWriter(record, RecordType::AdvertCreated)
+        .i32(advert.id)
+        .i32(advert.ownerId)
+        .str(advert.title)
+        .str(advert.description)
+        .f64(advert.price)
+        .i64(static_cast<int64_t>(advert.createdAt))
+        .finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::advertDeleted(int advertId)
+{
+    std::string record;
+    RecordWriter(record, RecordType::AdvertDeleted).i32(advertId).finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::responseAdded(int advertId, int userId)
+{
+    std::string record;
+    RecordWriter(record, RecordType::ResponseAdded).i32(advertId).i32(userId).finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::sessionOpened(const std::string &token, int userId)
+{
+    std::string record;
+    RecordWriter(record, RecordType::SessionOpened).str(token).i32(userId).finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::sessionClosed(const std::string &token)
+{
+    std::string record;
+    RecordWriter(record, RecordType::SessionClosed).str(token).finish();
+    return append(record);
+}
+
+uint64_t WriteAheadLog::append(const std::string &record)
+{
+    uint64_t sequence;
+    bool compact;
+    {
+        std::lock_guard lock(mutex_);
+        pending_.append(record);
+        sequence = ++appendedSequence_;
+        compact = ++recordsSinceSnapshot_ == snapshotEveryRecords_;
+    }
+    flushCv_.notify_one();
+    if (compact)
+    {
+        compactCv_.notify_one();
+    }
+    return sequence;
+}
+
+bool WriteAheadLog::waitDurable(uint64_t sequence)
+{
+    std::unique_lock lock(mutex_);
+    durableCv_.wait(lock, [&]()
+                    { return durableSequence_ >= sequence || failed_; });
+    return !failed_;
+}
+
+void WriteAheadLog::flushLoop()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        flushCv_.wait(lock, [this]()
+                      { return stopping_ || !pending_.empty(); });
+        if (pending_.empty())
+        {
+            return;
+        }
+        // Everything appended while the previous sync ran goes out together.
+        std::string batch;
+        batch.swap(pending_);
+        const uint64_t upTo = appendedSequence_;
+        std::unique_lock fileLock(fileMutex_);
+        lock.unlock();
+        const bool ok = writeAll(fd_, batch) && ::fdatasync(fd_) == 0;
+        if (!ok)
+        {
+            std::perror("wal: write");
+        }
+        fileLock.unlock();
+        lock.lock();
+        failed_ = failed_ || !ok;
+        durableSequence_ = std::max(durableSequence_, upTo);
+        durableCv_.notify_all();
+    }
+}
+
+uint64_t WriteAheadLog::rotate()
+{
+    std::lock_guard lock(mutex_);
+    std::lock_guard fileLock(fileMutex_);
+    // What is pending was appended before the cut, so it closes the old segment.
+    bool ok = writeAll(fd_, pending_) && ::fdatasync(fd_) == 0;
+    pending_.clear();
+    const int next = openSegment(directory_, segment_ + 1);
+    if (next >= 0)
+    {
+        ::close(fd_);
+        fd_ = next;
+        ++segment_;
+    }
+    ok = ok && next >= 0;
+    if (!ok)
+    {
+        std::perror("wal: rotate");
+    }
+    failed_ = failed_ || !ok;
+    durableSequence_ = appendedSequence_;
+    recordsSinceSnapshot_ = 0;
+    durableCv_.notify_all();
+    return segment_;
+}
+
+bool WriteAheadLog::snapshot()
+{
+    std::lock_guard snapshotLock(snapshotMutex_);
+    const uint64_t firstSegment = rotate();
+    const auto state = capture_();
+
+    std::string content;
+    RecordWriter(content, RecordType::SnapshotHeader)
+        .u32(kSnapshotMagic)
+        .u64(firstSegment)
+        .i32(state.nextUserId)
+        .i32(state.nextAdvertId)
+        .finish();
+    for (const auto &user : state.users)
+    {
+        RecordWriter(content, RecordType::UserRegistered).i32(user.id).str(user.name).str(user.email).str(user.passwordHash).finish();
+    }
+    for (const auto &advert : state.adverts)
+    {
+        RecordWriter(content, RecordType::AdvertCreated)
+            .i32(advert.id)
+            .i32(advert.ownerId)
+            .str(advert.title)
+            .str(advert.description)
+            .f64(advert.price)
+            .i64(static_cast<int64_t>(advert.createdAt))
+            .finish();
+    }
+    for (const auto &[advertId, userId] : state.responses)
+    {
+        RecordWriter(content, RecordType::ResponseAdded).i32(advertId).i32(userId).finish();
+    }
+    for (const auto &[token, userId] : state.sessions)
+    {
+        RecordWriter(content, RecordType::SessionOpened).str(token).i32(userId).finish();
+    }
+    RecordWriter(content, RecordType::SnapshotEnd).finish();
+
+    const auto temporary = directory_ / "snapshot.tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::perror("wal: snapshot");
+        return false;
+    }
+    bool ok = writeAll(fd, content) && ::fsync(fd) == 0;
+    ::close(fd);
+    std::error_code ec;
+    if (ok)
+    {
+        std::filesystem::rename(temporary, directory_ / kSnapshotName, ec);
+        ok = !ec && syncDirectory(directory_);
+    }
+    if (!ok)
+    {
+        std::cerr << "wal: failed to write snapshot" << std::endl;
+        return false;
+    }
+
+    for (const auto &entry : std::filesystem::directory_iterator(directory_, ec))
+    {
+        if (auto segment = parseSegmentName(entry.path().filename().string()); segment && *segment < firstSegment)
+        {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+    return true;
+}
+
+void WriteAheadLog::compactLoop()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        compactCv_.wait(lock, [this]()
+                        { return stopping_ || recordsSinceSnapshot_ >= snapshotEveryRecords_; });
+        if (stopping_)
+        {
+            return;
+        }
+        lock.unlock();
+        [[maybe_unused]] const bool ok = snapshot();
+        lock.lock();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "store.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Everything that survives a restart, as plain values.
+struct PersistedState
+{
+    std::vector<User> users;                           // sorted by id, ids 1..n
+    std::vector<Advertisement> adverts;                // in creation order
+    std::vector<std::pair<int, int>> responses;        // (advert id, user id)
+    std::vector<std::pair<std::string, int>> sessions; // (token, user id)
+    int nextUserId = 1;
+    int nextAdvertId = 1;
+
+    [[nodiscard]] bool empty() const { return users.empty() && adverts.empty(); }
+};
+
+// Append-only journal of mutations in a data directory:
+//
+//   wal-<segment>.log   records in the order they were applied in memory
+//   snapshot.bin        the full state, covering every segment before the
+//                       one named in its header
+//
+// Appends are buffered and a single flusher thread writes and fdatasync()s
+// whatever accumulated while the previous sync was running, so concurrent
+// writers share one disk flush. Once enough records pile up, a compaction
+// thread starts a new segment, captures the state, writes it as the snapshot
+// and deletes the segments it covers.
+//
+// Replaying a record is idempotent, which lets the snapshot be taken while
+// writers keep going: it may already contain some records of the segment it
+// is replayed with.
+class WriteAheadLog
+{
+public:
+    using Capture = std::function<PersistedState()>;
+
+    explicit WriteAheadLog(std::filesystem::path directory, size_t snapshotEveryRecords = 100000);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    // Loads the snapshot and replays the segments after it. Call once, before open().
+    [[nodiscard]] bool recover(PersistedState &state);
+
+    // Starts a new segment and the background threads. `capture` runs on the
+    // compaction thread and must reflect at least every record appended
+    // before it was called.
+    [[nodiscard]] bool open(Capture capture);
+
+    // Each appender returns the record's sequence number. Call them under the
+    // lock that orders the mutation in memory, after applying it.
+    uint64_t userRegistered(const User &user);
+    uint64_t advertCreated(const Advertisement &advert);
+    uint64_t advertDeleted(int advertId);
+    uint64_t responseAdded(int advertId, int userId);
+    uint64_t sessionOpened(const std::string &token, int userId);
+    uint64_t sessionClosed(const std::string &token);
+
+    // Blocks until the record is on disk; false if the log could not be written.
+    [[nodiscard]] bool waitDurable(uint64_t sequence);
+
+    // Writes a snapshot now instead of waiting for the record threshold.
+    [[nodiscard]] bool snapshot();
+
+private:
+    uint64_t append(const std::string &record);
+    uint64_t rotate();
+    void flushLoop();
+    void compactLoop();
+
+    std::filesystem::path directory_;
+    size_t snapshotEveryRecords_;
+    Capture capture_;
+
+    // Guards the pending buffer, the sequence counters and the flags.
+    std::mutex mutex_;
+    std::condition_variable flushCv_;
+    std::condition_variable durableCv_;
+    std::condition_variable compactCv_;
+    std::string pending_;
+    uint64_t appendedSequence_ = 0;
+    uint64_t durableSequence_ = 0;
+    size_t recordsSinceSnapshot_ = 0;
+    bool stopping_ = false;
+    bool failed_ = false;
+
+    // Guards the open segment. Taken after mutex_ when both are needed; the
+    // flusher holds only this one while writing.
+    std::mutex fileMutex_;
+    int fd_ = -1;
+    uint64_t segment_ = 0;
+
+    std::mutex snapshotMutex_;
+    std::thread flusher_;
+    std::thread compactor_;
+};
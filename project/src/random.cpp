@@ -0,0 +1,58 @@
+#include "random.hpp"
+
+#include <sys/random.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    struct RandomBuffer
+    {
+        unsigned char bytes[4096];
+        size_t used = sizeof(bytes);
+
+        void refill()
+        {
+            for (size_t filled = 0; filled < sizeof(bytes);)
+            {
+                const ssize_t result = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+                if (result < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    // Predictable tokens would be worse than not running at all.
+                    std::perror("getrandom");
+                    std::abort();
+                }
+                filled += static_cast<size_t>(result);
+            }
+            used = 0;
+        }
+    };
+}
+
+void secureRandomBytes(void *data, size_t size)
+{
+    static thread_local RandomBuffer buffer;
+    auto *out = static_cast<unsigned char *>(data);
+    while (size > 0)
+    {
+        if (buffer.used == sizeof(buffer.bytes))
+        {
+            buffer.refill();
+        }
+        const size_t chunk = std::min(size, sizeof(buffer.bytes) - buffer.used);
+        std::memcpy(out, buffer.bytes + buffer.used, chunk);
+        // Bytes that have been handed out must not stay around to leak later.
+        std::memset(buffer.bytes + buffer.used, 0, chunk);
+        buffer.used += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
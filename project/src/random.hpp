@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+// Fills `data` with cryptographically secure random bytes. Each thread keeps
+// a buffer refilled from getrandom(2), so small requests such as session
+// tokens and salts rarely need a system call.
+void secureRandomBytes(void *data, size_t size);
@@ -0,0 +1,196 @@
+#include "rate_limit.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr uint64_t kTokenUnit = 256;
+    constexpr int kTokenBits = 24;
+    constexpr uint64_t kTokenMask = (uint64_t(1) << kTokenBits) - 1;
+
+    uint64_t mix(uint64_t value)
+    {
+        // splitmix64 finalizer
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebULL;
+        value ^= value >> 31;
+        return value;
+    }
+
+    std::vector<RateLimiter::Limit> clampLimits(std::vector<RateLimiter::Limit> limits)
+    {
+        // The burst has to fit the 24 bits a bucket keeps its tokens in.
+        const double maxBurst = static_cast<double>(kTokenMask / kTokenUnit);
+        for (auto &limit : limits)
+        {
+            limit.perSecond = std::max(0.0, limit.perSecond);
+            limit.burst = std::clamp(limit.burst, 1.0, maxBurst);
+        }
+        return limits;
+    }
+
+    uint64_t idleMillis(const std::vector<RateLimiter::Limit> &limits)
+    {
+        double longest = 0;
+        for (const auto &limit : limits)
+        {
+            if (limit.perSecond > 0)
+            {
+                longest = std::max(longest, limit.burst / limit.perSecond * 1000);
+            }
+        }
+        return static_cast<uint64_t>(std::ceil(longest)) + 1;
+    }
+
+    size_t setCount(size_t capacity, size_t ways)
+    {
+        size_t sets = 1;
+        while (sets * ways < capacity)
+        {
+            sets <<= 1;
+        }
+        return sets;
+    }
+}
+
+RateLimiter::RateLimiter(std::vector<Limit> limits, size_t capacity)
+    : limits_(clampLimits(std::move(limits))),
+      idleMillis_(idleMillis(limits_)),
+      setCount_(setCount(capacity, kWays)),
+      sets_(std::make_unique<Set[]>(setCount_)),
+      start_(std::chrono::steady_clock::now()),
+      nextSweep_(nowMillis() + std::chrono::milliseconds(kSweepInterval).count())
+{
+}
+
+uint64_t RateLimiter::nowMillis() const
+{
+    // Offset so that a bucket word of 0 (time 0, no tokens) has always
+    // refilled completely: that is what a fresh bucket looks like.
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) +
+           idleMillis_;
+}
+
+bool RateLimiter::tryAcquire(size_t limit, uint64_t key, uint32_t &retryAfter)
+{
+    if (limit >= limits_.size() || limits_[limit].perSecond <= 0)
+    {
+        return true;
+    }
+
+    const uint64_t now = nowMillis();
+    if (uint64_t due = nextSweep_.load(std::memory_order_relaxed); now >= due)
+    {
+        const uint64_t next = now + std::chrono::milliseconds(kSweepInterval).count();
+        if (nextSweep_.compare_exchange_strong(due, next, std::memory_order_relaxed))
+        {
+            sweep(now);
+        }
+    }
+
+    const uint64_t hash = std::max<uint64_t>(1, mix(key ^ mix(limit + 1)));
+    Set &set = sets_[hash & (setCount_ - 1)];
+    while (true)
+    {
+        for (auto &slot : set.slots)
+        {
+            if (slot.key.load(std::memory_order_acquire) == hash)
+            {
+                return take(slot, limits_[limit], now, retryAfter);
+            }
+        }
+
+        // Not here yet: move into a free slot, or else take over the one
+        // whose last token is the oldest.
+        Slot *victim = nullptr;
+        uint64_t victimKey = 0;
+        uint64_t oldest = UINT64_MAX;
+        for (auto &slot : set.slots)
+        {
+            const uint64_t current = slot.key.load(std::memory_order_acquire);
+            const uint64_t taken = slot.bucket.load(std::memory_order_relaxed) >> kTokenBits;
+            if (current == 0)
+            {
+                victim = &slot;
+                victimKey = 0;
+                break;
+            }
+            if (taken < oldest)
+            {
+                victim = &slot;
+                victimKey = current;
+                oldest = taken;
+            }
+        }
+        if (victim->key.compare_exchange_strong(victimKey, hash, std::memory_order_acq_rel))
+        {
+            if (victimKey != 0)
+            {
+                victim->bucket.store(0, std::memory_order_relaxed);
+            }
+            return take(*victim, limits_[limit], now, retryAfter);
+        }
+        // Someone else changed the set meanwhile, possibly adding this very key.
+    }
+}
+
+bool RateLimiter::take(Slot &slot, const Limit &limit, uint64_t now, uint32_t &retryAfter) const
+{
+    const double capacity = limit.burst * kTokenUnit;
+    const double perMilli = limit.perSecond * kTokenUnit / 1000;
+    uint64_t current = slot.bucket.load(std::memory_order_relaxed);
+    while (true)
+    {
+        const uint64_t then = current >> kTokenBits;
+        const double elapsed = now > then ? static_cast<double>(now - then) : 0;
+        const double tokens = std::min(capacity, static_cast<double>(current & kTokenMask) + elapsed * perMilli);
+        if (tokens < kTokenUnit)
+        {
+            // Nothing is written: the time of the last token stays, so the
+            // refill keeps counting however hard an empty bucket is hit.
+            retryAfter = static_cast<uint32_t>(std::ceil((kTokenUnit - tokens) / perMilli / 1000));
+            retryAfter = std::max<uint32_t>(1, retryAfter);
+            return false;
+        }
+        const uint64_t next = (now << kTokenBits) | static_cast<uint64_t>(tokens - kTokenUnit);
+        if (slot.bucket.compare_exchange_weak(current, next, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+}
+
+void RateLimiter::sweep(uint64_t now)
+{
+    for (size_t i = 0; i < setCount_; ++i)
+    {
+        for (auto &slot : sets_[i].slots)
+        {
+            uint64_t key = slot.key.load(std::memory_order_relaxed);
+            const uint64_t taken = slot.bucket.load(std::memory_order_relaxed) >> kTokenBits;
+            if (key != 0 && now - std::min(now, taken) >= idleMillis_)
+            {
+                // Its bucket is full, so the slot can go; the stale word left
+                // behind reads as full too for whoever moves in.
+                slot.key.compare_exchange_strong(key, 0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+size_t RateLimiter::size() const
+{
+    size_t used = 0;
+    for (size_t i = 0; i < setCount_; ++i)
+    {
+        for (const auto &slot : sets_[i].slots)
+        {
+            used += slot.key.load(std::memory_order_relaxed) != 0 ? 1 : 0;
+        }
+    }
+    return used;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Token buckets per client key (an address or a session token under one of
+// the configured limits), in a fixed table so memory never grows.
+//
+// Nothing takes a lock. The table is split into sets of four slots, one
+// cache line each; a key only ever lives in the set its hash picks, so a
+// lookup reads at most four slots and a slot can be handed to another key
+// without breaking anyone's lookup. A bucket is a single word (tokens and
+// the time they were last counted) updated with compare-and-swap.
+//
+// A bucket left alone until it has refilled completely is no different from
+// a fresh one. Every kSweepInterval one caller clears all such buckets, and
+// a key that finds its set full takes over the bucket idle the longest.
+class RateLimiter
+{
+public:
+    struct Limit
+    {
+        // Zero rate: the limit is off.
+        double perSecond = 0;
+        double burst = 1;
+    };
+
+    static constexpr std::chrono::seconds kSweepInterval{10};
+
+    RateLimiter(std::vector<Limit> limits, size_t capacity);
+
+    RateLimiter(const RateLimiter &) = delete;
+    RateLimiter &operator=(const RateLimiter &) = delete;
+
+    // Takes a token from `key`'s bucket under limits[limit]. When there is
+    // none, returns false with `retryAfter` set to the whole seconds until
+    // there will be.
+    bool tryAcquire(size_t limit, uint64_t key, uint32_t &retryAfter);
+
+    // Buckets currently held by some key.
+    [[nodiscard]] size_t size() const;
+
+private:
+    static constexpr size_t kWays = 4;
+
+    struct Slot
+    {
+        // Hash of the limit and the client key; 0 when free.
+        std::atomic<uint64_t> key{0};
+        // Milliseconds since start_ (high 40 bits) and tokens in 1/256ths
+        // (low 24 bits) as of the last token taken.
+        std::atomic<uint64_t> bucket{0};
+    };
+
+    struct alignas(64) Set
+    {
+        Slot slots[kWays];
+    };
+
+    [[nodiscard]] uint64_t nowMillis() const;
+    bool take(Slot &slot, const Limit &limit, uint64_t now, uint32_t &retryAfter) const;
+    void sweep(uint64_t now);
+
+    const std::vector<Limit> limits_;
+    // Time after which any bucket has refilled completely.
+    const uint64_t idleMillis_;
+    const size_t setCount_;
+    std::unique_ptr<Set[]> sets_;
+    const std::chrono::steady_clock::time_point start_;
+    std::atomic<uint64_t> nextSweep_;
+};
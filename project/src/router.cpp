@@ -0,0 +1,164 @@
+#include "router.hpp"
+
+namespace
+{
+    constexpr const char *kMethodNames[kHttpMethodCount] = {"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"};
+
+    // Splits off the segment before the next '/', leaving the rest in `path`.
+    std::string_view nextSegment(std::string_view &path)
+    {
+        const auto slash = path.find('/');
+        const auto segment = path.substr(0, slash);
+        path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+        return segment;
+    }
+
+    bool isCapture(std::string_view segment)
+    {
+        return segment.size() >= 2 && segment.front() == '{' && segment.back() == '}';
+    }
+}
+
+std::optional<HttpMethod> parseMethod(std::string_view method)
+{
+    for (size_t i = 0; i < kHttpMethodCount; ++i)
+    {
+        if (method == kMethodNames[i])
+        {
+            return static_cast<HttpMethod>(i);
+        }
+    }
+    return std::nullopt;
+}
+
+const char *methodName(HttpMethod method)
+{
+    return kMethodNames[static_cast<size_t>(method)];
+}
+
+void RouteTrie::add(HttpMethod method, std::string_view pattern, size_t route)
+{
+    if (pattern.empty() || pattern.front() != '/')
+    {
+        throw std::invalid_argument("route pattern must start with '/'");
+    }
+    pattern.remove_prefix(1);
+
+    uint32_t node = 0;
+    while (true)
+    {
+        const auto segment = nextSegment(pattern);
+        uint32_t child = kNone;
+        if (isCapture(segment))
+        {
+            child = nodes_[node].capture;
+            if (child == kNone)
+            {
+                child = static_cast<uint32_t>(nodes_.size());
+                nodes_[node].capture = child;
+                nodes_.emplace_back();
+            }
+        }
+        else
+        {
+            for (const auto &[literal, index] : nodes_[node].literals)
+            {
+                if (literal == segment)
+                {
+                    child = index;
+                    break;
+                }
+            }
+            if (child == kNone)
+            {
+                child = static_cast<uint32_t>(nodes_.size());
+                nodes_[node].literals.emplace_back(segment, child);
+                nodes_.emplace_back();
+            }
+        }
+        node = child;
+        if (pattern.data() == nullptr)
+        {
+            break;
+        }
+    }
+
+    auto &slot = nodes_[node].routes[static_cast<size_t>(method)];
+    if (slot != kNone)
+    {
+        throw std::invalid_argument("duplicate route");
+    }
+    slot = static_cast<uint32_t>(route);
+}
+
+uint32_t RouteTrie::walk(uint32_t node, std::string_view path, RouteCaptures &captures, size_t depth) const
+{
+    if (path.data() == nullptr)
+    {
+        const auto &routes = nodes_[node].routes;
+        for (uint32_t route : routes)
+        {
+            if (route != kNone)
+            {
+                return node;
+            }
+        }
+        return kNone;
+    }
+
+    const auto segment = nextSegment(path);
+    for (const auto &[literal, child] : nodes_[node].literals)
+    {
+        if (literal == segment)
+        {
+            const uint32_t found = walk(child, path, captures, depth);
+            if (found != kNone)
+            {
+                return found;
+            }
+            break;
+        }
+    }
+    // An empty segment ("/api/ads/") never fills a placeholder.
+    const uint32_t capture = nodes_[node].capture;
+    if (capture != kNone && !segment.empty() && depth < kMaxRouteCaptures)
+    {
+        captures[depth] = segment;
+        return walk(capture, path, captures, depth + 1);
+    }
+    return kNone;
+}
+
+RouteTrie::Match RouteTrie::match(HttpMethod method, std::string_view path) const
+{
+    Match result;
+    if (path.empty() || path.front() != '/')
+    {
+        return result;
+    }
+    path.remove_prefix(1);
+
+    const uint32_t node = walk(0, path, result.captures, 0);
+    if (node == kNone)
+    {
+        return result;
+    }
+
+    const auto &routes = nodes_[node].routes;
+    const uint32_t route = routes[static_cast<size_t>(method)];
+    if (route == kNone)
+    {
+        result.kind = Match::Kind::WrongMethod;
+        for (size_t i = 0; i < kHttpMethodCount; ++i)
+        {
+            if (routes[i] != kNone)
+            {
+                result.allowed |= uint32_t(1) << i;
+            }
+        }
+        return result;
+    }
+    result.kind = Match::Kind::Found;
+    result.route = route;
+    return result;
+}
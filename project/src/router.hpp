@@ -0,0 +1,272 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class HttpMethod : uint8_t
+{
+    Get,
+    Head,
+    Post,
+    Put,
+    Patch,
+    Delete,
+    Options,
+};
+
+constexpr size_t kHttpMethodCount = 7;
+
+std::optional<HttpMethod> parseMethod(std::string_view method);
+const char *methodName(HttpMethod method);
+
+// Segments that matched the {placeholders} of a pattern, in order.
+constexpr size_t kMaxRouteCaptures = 4;
+using RouteCaptures = std::array<std::string_view, kMaxRouteCaptures>;
+
+// Path patterns as a tree of '/'-separated segments. A literal segment wins
+// over a {placeholder} at the same position, so "/api/ads/search" is never
+// taken for an advert id. Matching walks the path once without allocating.
+class RouteTrie
+{
+public:
+    struct Match
+    {
+        enum class Kind
+        {
+            NotFound,
+            WrongMethod,
+            Found,
+        };
+
+        Kind kind = Kind::NotFound;
+        size_t route = 0;
+        RouteCaptures captures{};
+        // With WrongMethod: bit i set if HttpMethod(i) is routed for the path.
+        uint32_t allowed = 0;
+    };
+
+    void add(HttpMethod method, std::string_view pattern, size_t route);
+    [[nodiscard]] Match match(HttpMethod method, std::string_view path) const;
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node
+    {
+        std::vector<std::pair<std::string_view, uint32_t>> literals;
+        uint32_t capture = kNone;
+        std::array<uint32_t, kHttpMethodCount> routes;
+
+        Node() { routes.fill(kNone); }
+    };
+
+    // Index of the node the rest of `path` leads to from `node`, or kNone.
+    [[nodiscard]] uint32_t walk(uint32_t node, std::string_view path, RouteCaptures &captures, size_t depth) const;
+
+    std::vector<Node> nodes_ = std::vector<Node>(1);
+};
+
+// Turns a path segment into the type a handler declares for it.
+template <typename T>
+bool parseCapture(std::string_view segment, T &value)
+{
+    if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        value = segment;
+        return true;
+    }
+    else
+    {
+        static_assert(std::is_integral_v<T>, "route captures are integers or string views");
+        // Digits only: no sign, no leading '+' and nothing after the number.
+        if (segment.empty() || segment.front() < '0' || segment.front() > '9')
+        {
+            return false;
+        }
+        const auto [end, ec] = std::from_chars(segment.data(), segment.data() + segment.size(), value);
+        return ec == std::errc() && end == segment.data() + segment.size();
+    }
+}
+
+constexpr size_t countRouteCaptures(std::string_view pattern)
+{
+    size_t count = 0;
+    for (char ch : pattern)
+    {
+        count += ch == '{' ? 1 : 0;
+    }
+    return count;
+}
+
+template <typename Context>
+struct Route
+{
+    HttpMethod method;
+    std::string_view pattern;
+    // False when a capture does not parse as its declared type.
+    bool (*invoke)(Context &, const HttpRequest &, HttpResponse &, const RouteCaptures &);
+    // Whether every capture parses as its declared type, without calling anything.
+    bool (*accepts)(const RouteCaptures &);
+    // Which of the application's rate limits the route is under; 0 for none.
+    uint8_t rateLimit = 0;
+};
+
+template <typename Handler>
+struct RouteHandlerTraits;
+
+template <typename Context, typename... Captures>
+struct RouteHandlerTraits<void (Context::*)(const HttpRequest &, HttpResponse &, Captures...)>
+{
+    using ContextType = Context;
+    static constexpr size_t kCaptureCount = sizeof...(Captures);
+
+    template <auto Handler>
+    static bool invoke(Context &context, const HttpRequest &request, HttpResponse &response,
+                       const RouteCaptures &captures)
+    {
+        return invokeWith<Handler>(context, request, response, captures, std::index_sequence_for<Captures...>{});
+    }
+
+    static bool accepts(const RouteCaptures &captures)
+    {
+        return acceptsWith(captures, std::index_sequence_for<Captures...>{});
+    }
+
+private:
+    template <size_t... I>
+    static bool acceptsWith(const RouteCaptures &captures, std::index_sequence<I...>)
+    {
+        std::tuple<std::decay_t<Captures>...> values;
+        return (parseCapture(captures[I], std::get<I>(values)) && ...);
+    }
+
+    template <auto Handler, size_t... I>
+    static bool invokeWith(Context &context, const HttpRequest &request, HttpResponse &response,
+                           const RouteCaptures &captures, std::index_sequence<I...>)
+    {
+        std::tuple<std::decay_t<Captures>...> values;
+        if (!(parseCapture(captures[I], std::get<I>(values)) && ...))
+        {
+            return false;
+        }
+        (context.*Handler)(request, response, std::get<I>(values)...);
+        return true;
+    }
+};
+
+// Declares `Handler` for `method` and `pattern`. The handler takes one extra
+// argument per {placeholder}, in order; used in a constexpr table, a mismatch
+// between the two is a compile error.
+template <auto Handler>
+constexpr auto route(HttpMethod method, std::string_view pattern, uint8_t rateLimit = 0)
+{
+    using Traits = RouteHandlerTraits<decltype(Handler)>;
+    static_assert(Traits::kCaptureCount <= kMaxRouteCaptures, "too many route captures");
+    if (countRouteCaptures(pattern) != Traits::kCaptureCount)
+    {
+        throw std::logic_error("route pattern and handler disagree on the number of captures");
+    }
+    return Route<typename Traits::ContextType>{method, pattern, &Traits::template invoke<Handler>, &Traits::accepts,
+                                               rateLimit};
+}
+
+// Dispatches requests over a fixed table of routes. Patterns are views, so
+// the table must outlive the router (normally it is a static constexpr array).
+template <typename Context>
+class Router
+{
+public:
+    // Called with a matched route whose captures parse, before its handler.
+    // Returning false means the request was answered here and the handler is
+    // skipped.
+    using Admit = bool (*)(Context &, const Route<Context> &, const HttpRequest &, HttpResponse &);
+
+    template <size_t N>
+    explicit Router(const Route<Context> (&routes)[N]) : routes_(routes, routes + N)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            trie_.add(routes[i].method, routes[i].pattern, i);
+        }
+    }
+
+    // False if no route matches. A path that is routed for other methods is
+    // answered with 405 and an Allow header. `route` is set to the index of
+    // the route whose handler ran or whose `admit` turned the request away,
+    // and left alone otherwise.
+    bool dispatch(Context &context, const HttpRequest &request, HttpResponse &response, size_t &route,
+                  Admit admit = nullptr) const
+    {
+        const auto method = parseMethod(request.method);
+        if (!method)
+        {
+            return false;
+        }
+        const auto match = trie_.match(*method, request.path);
+        switch (match.kind)
+        {
+        case RouteTrie::Match::Kind::NotFound:
+            return false;
+        case RouteTrie::Match::Kind::WrongMethod:
+            respondMethodNotAllowed(response, match.allowed);
+            return true;
+        case RouteTrie::Match::Kind::Found:
+            break;
+        }
+        // A capture that does not parse ("/api/ads/abc") is as unknown as any
+        // other path, and is answered before `admit` can count it.
+        const auto &matched = routes_[match.route];
+        if (!matched.accepts(match.captures))
+        {
+            return false;
+        }
+        if (admit && !admit(context, matched, request, response))
+        {
+            route = match.route;
+            return true;
+        }
+        if (!matched.invoke(context, request, response, match.captures))
+        {
+            return false;
+        }
+        route = match.route;
+        return true;
+    }
+
+    [[nodiscard]] const std::vector<Route<Context>> &routes() const { return routes_; }
+
+private:
+    static void respondMethodNotAllowed(HttpResponse &response, uint32_t allowed)
+    {
+        std::pmr::string allow(response.body.get_allocator());
+        for (size_t i = 0; i < kHttpMethodCount; ++i)
+        {
+            if (allowed & (uint32_t(1) << i))
+            {
+                if (!allow.empty())
+                {
+                    allow.append(", ");
+                }
+                allow.append(methodName(static_cast<HttpMethod>(i)));
+            }
+        }
+        response.status = 405;
+        response.setHeader("Allow", allow);
+        response.body = R"({"error":"Method not allowed"})";
+    }
+
+    std::vector<Route<Context>> routes_;
+    RouteTrie trie_;
+};
@@ -0,0 +1,372 @@
+#include "search.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    constexpr size_t kMaxWordBytes = 64;
+    // Shorter query words match only themselves: "ka" or "по" would expand
+    // to a large share of the vocabulary, and every expansion is merged.
+    constexpr size_t kMinPrefixCharacters = 3;
+    constexpr uint16_t kTitleWeight = 2;
+    constexpr double kPrefixFactor = 0.5;
+    // Relevance halves for an advert one week old, thirds at two weeks, ...
+    constexpr double kRecencyHalfLifeSeconds = 7 * 24 * 3600.0;
+
+    bool isWordByte(unsigned char ch)
+    {
+        return ch >= 0x80 || (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+    }
+
+    void appendFolded(std::string &word, std::string_view text, size_t &i)
+    {
+        const auto ch = static_cast<unsigned char>(text[i]);
+        if (ch < 0x80)
+        {
+            word.push_back(static_cast<char>(ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch));
+            return;
+        }
+        // Two-byte Cyrillic: U+0400..U+042F -> lower case, U+0451 (ё) -> U+0435 (е).
+        if ((ch == 0xD0 || ch == 0xD1) && i + 1 < text.size())
+        {
+            const auto next = static_cast<unsigned char>(text[i + 1]);
+            unsigned codepoint = ((ch & 0x1Fu) << 6) | (next & 0x3Fu);
+            if (codepoint >= 0x400 && codepoint < 0x410)
+            {
+                codepoint += 0x50;
+            }
+            else if (codepoint >= 0x410 && codepoint < 0x430)
+            {
+                codepoint += 0x20;
+            }
+            if (codepoint == 0x451)
+            {
+                codepoint = 0x435;
+            }
+            word.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+            word.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+            ++i;
+            return;
+        }
+        word.push_back(static_cast<char>(ch));
+    }
+
+    // UTF-8 characters in a word: every byte but the continuation ones.
+    size_t characterCount(std::string_view word)
+    {
+        return static_cast<size_t>(std::count_if(word.begin(), word.end(), [](char ch)
+                                                 { return (static_cast<unsigned char>(ch) & 0xC0) != 0x80; }));
+    }
+
+    // Word -> weight for one advert.
+    std::unordered_map<std::string, uint16_t> weighWords(std::string_view title, std::string_view description)
+    {
+        std::unordered_map<std::string, uint16_t> weights;
+        const auto addWords = [&weights](std::string_view text, uint16_t weight)
+        {
+            for (auto &word : tokenizeForSearch(text))
+            {
+                auto &total = weights[std::move(word)];
+                total = static_cast<uint16_t>(std::min<unsigned>(UINT16_MAX, total + weight));
+            }
+        };
+        addWords(title, kTitleWeight);
+        addWords(description, 1);
+        return weights;
+    }
+}
+
+std::vector<std::string> tokenizeForSearch(std::string_view text)
+{
+    std::vector<std::string> words;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i)
+    {
+        if (i < text.size() && isWordByte(static_cast<unsigned char>(text[i])))
+        {
+            appendFolded(word, text, i);
+            continue;
+        }
+        if (!word.empty())
+        {
+            if (word.size() <= kMaxWordBytes)
+            {
+                words.push_back(std::move(word));
+            }
+            word.clear();
+        }
+    }
+    return words;
+}
+
+void SearchIndex::add(int adId, std::time_t createdAt, std::string_view title, std::string_view description)
+{
+    const auto weights = weighWords(title, description);
+
+    std::unique_lock lock(mutex_);
+    if (static_cast<size_t>(adId) >= createdAt_.size())
+    {
+        createdAt_.resize(static_cast<size_t>(adId) + 1);
+    }
+    createdAt_[static_cast<size_t>(adId)] = createdAt;
+
+    for (const auto &[word, weight] : weights)
+    {
+        auto &postings = terms_[word].postings;
+        // Ids grow monotonically, so this is almost always an append.
+        auto pos = postings.end();
+        if (!postings.empty() && postings.back().adId > adId)
+        {
+            pos = std::lower_bound(postings.begin(), postings.end(), adId, [](const Posting &posting, int id)
+                                   { return posting.adId < id; });
+        }
+        postings.insert(pos, Posting{adId, weight});
+    }
+}
+
+void SearchIndex::remove(int adId, std::string_view title, std::string_view description)
+{
+    const auto weights = weighWords(title, description);
+
+    std::unique_lock lock(mutex_);
+    for (const auto &[word, weight] : weights)
+    {
+        auto term = terms_.find(word);
+        if (term == terms_.end())
+        {
+            continue;
+        }
+        auto &list = term->second;
+        auto it = std::lower_bound(list.postings.begin(), list.postings.end(), adId, [](const Posting &posting, int id)
+                                   { return posting.adId < id; });
+        if (it == list.postings.end() || it->adId != adId || it->weight == 0)
+        {
+            continue;
+        }
+        // Tombstone, and compact once half of the list is dead.
+        it->weight = 0;
+        if (++list.dead * 2 >= list.postings.size())
+        {
+            list.postings.erase(std::remove_if(list.postings.begin(), list.postings.end(), [](const Posting &posting)
+                                               { return posting.weight == 0; }),
+                                list.postings.end());
+            list.dead = 0;
+        }
+        if (list.postings.empty())
+        {
+            terms_.erase(term);
+        }
+    }
+}
+
+std::vector<SearchIndex::TermMatch> SearchIndex::matchTerm(const std::string &word) const
+{
+    std::vector<TermMatch> matches;
+    if (characterCount(word) < kMinPrefixCharacters)
+    {
+        if (auto it = terms_.find(word); it != terms_.end())
+        {
+            matches.push_back({&it->second, 1.0});
+        }
+        return matches;
+    }
+    for (auto it = terms_.lower_bound(word); it != terms_.end() && it->first.compare(0, word.size(), word) == 0; ++it)
+    {
+        matches.push_back({&it->second, it->first.size() == word.size() ? 1.0 : kPrefixFactor});
+    }
+    return matches;
+}
+
+template <typename Fn>
+void SearchIndex::mergePostings(const std::vector<TermMatch> &matches, Fn &&fn)
+{
+    // One cursor per list; the smallest next id is at the front.
+    struct Cursor
+    {
+        int adId;
+        size_t match;
+        size_t position;
+    };
+    const auto after = [](const Cursor &lhs, const Cursor &rhs) { return lhs.adId > rhs.adId; };
+    std::vector<Cursor> heap;
+    heap.reserve(matches.size());
+    for (size_t i = 0; i < matches.size(); ++i)
+    {
+        if (!matches[i].list->postings.empty())
+        {
+            heap.push_back({matches[i].list->postings.front().adId, i, 0});
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    int current = 0; // advert ids start at 1
+    double score = 0.0;
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        auto &cursor = heap.back();
+        const auto &match = matches[cursor.match];
+        const auto &postings = match.list->postings;
+        if (cursor.adId != current)
+        {
+            if (score > 0.0)
+            {
+                fn(current, score);
+            }
+            current = cursor.adId;
+            score = 0.0;
+        }
+        score += postings[cursor.position].weight * match.factor;
+        if (++cursor.position < postings.size())
+        {
+            cursor.adId = postings[cursor.position].adId;
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+        else
+        {
+            heap.pop_back();
+        }
+    }
+    if (score > 0.0)
+    {
+        fn(current, score);
+    }
+}
+
+std::vector<SearchIndex::Hit> SearchIndex::search(std::string_view query, size_t limit, std::time_t now) const
+{
+    auto words = tokenizeForSearch(query);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty() || limit == 0)
+    {
+        return {};
+    }
+
+    std::shared_lock lock(mutex_);
+
+    std::vector<std::vector<TermMatch>> matches;
+    matches.reserve(words.size());
+    size_t driver = 0;
+    size_t driverSize = SIZE_MAX;
+    for (const auto &word : words)
+    {
+        auto termMatches = matchTerm(word);
+        if (termMatches.empty())
+        {
+            return {};
+        }
+        size_t size = 0;
+        for (const auto &match : termMatches)
+        {
+            size += match.list->postings.size();
+        }
+        if (size < driverSize)
+        {
+            driverSize = size;
+            driver = matches.size();
+        }
+        matches.push_back(std::move(termMatches));
+    }
+
+    // Newest first among equal scores; the heap below keeps its worst on top.
+    const auto better = [](const Hit &lhs, const Hit &rhs)
+    {
+        return lhs.score != rhs.score ? lhs.score > rhs.score : lhs.adId > rhs.adId;
+    };
+    std::vector<Hit> top;
+    top.reserve(std::min(limit, driverSize) + 1);
+    const auto offer = [&](int adId, double score)
+    {
+        const auto created = createdAt_[static_cast<size_t>(adId)];
+        const double age = std::max(0.0, static_cast<double>(now - created));
+        const Hit hit{adId, score / (1.0 + age / kRecencyHalfLifeSeconds)};
+        if (top.size() < limit)
+        {
+            top.push_back(hit);
+            std::push_heap(top.begin(), top.end(), better);
+        }
+        else if (better(hit, top.front()))
+        {
+            std::pop_heap(top.begin(), top.end(), better);
+            top.back() = hit;
+            std::push_heap(top.begin(), top.end(), better);
+        }
+    };
+    const auto ranked = [&]
+    {
+        std::sort_heap(top.begin(), top.end(), better);
+        return std::move(top);
+    };
+
+    // Candidates come from the word with the fewest postings, merged across its
+    // prefix expansions in id order. A lone word is ranked straight from the
+    // merge.
+    if (matches.size() == 1)
+    {
+        mergePostings(matches[driver], offer);
+        return ranked();
+    }
+    std::vector<Hit> candidates;
+    candidates.reserve(driverSize);
+    mergePostings(matches[driver], [&candidates](int adId, double score)
+                  { candidates.push_back({adId, score}); });
+
+    // Every other word must match too. Each of its expansions is intersected
+    // with the candidates from the smaller side, binary-searching the larger,
+    // so a prefix with thousands of short expansions costs about as much as
+    // their postings and never more than the candidates times expansions.
+    std::vector<double> scores;
+    for (size_t w = 0; w < matches.size(); ++w)
+    {
+        if (w == driver)
+        {
+            continue;
+        }
+        scores.assign(candidates.size(), 0.0);
+        for (const auto &match : matches[w])
+        {
+            const auto &postings = match.list->postings;
+            if (postings.size() > candidates.size())
+            {
+                for (size_t i = 0; i < candidates.size(); ++i)
+                {
+                    auto it = std::lower_bound(postings.begin(), postings.end(), candidates[i].adId,
+                                               [](const Posting &posting, int id) { return posting.adId < id; });
+                    if (it != postings.end() && it->adId == candidates[i].adId)
+                    {
+                        scores[i] += it->weight * match.factor;
+                    }
+                }
+                continue;
+            }
+            for (const auto &posting : postings)
+            {
+                auto it = std::lower_bound(candidates.begin(), candidates.end(), posting.adId,
+                                           [](const Hit &hit, int id) { return hit.adId < id; });
+                if (it != candidates.end() && it->adId == posting.adId)
+                {
+                    scores[static_cast<size_t>(it - candidates.begin())] += posting.weight * match.factor;
+                }
+            }
+        }
+        size_t out = 0;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            if (scores[i] > 0.0)
+            {
+                candidates[out++] = {candidates[i].adId, candidates[i].score + scores[i]};
+            }
+        }
+        candidates.resize(out);
+    }
+
+    for (const auto &candidate : candidates)
+    {
+        offer(candidate.adId, candidate.score);
+    }
+    return ranked();
+}
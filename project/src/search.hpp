@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Splits text into lower-cased words. ASCII letters/digits and all non-ASCII
+// UTF-8 sequences are word characters; Cyrillic capitals are folded and
+// "ё" is treated as "е".
+std::vector<std::string> tokenizeForSearch(std::string_view text);
+
+// Inverted index over advert titles and descriptions, kept up to date as
+// adverts are created and deleted.
+class SearchIndex
+{
+public:
+    struct Hit
+    {
+        int adId = 0;
+        double score = 0.0;
+    };
+
+    void add(int adId, std::time_t createdAt, std::string_view title, std::string_view description);
+    // Takes the same texts the advert was added with.
+    void remove(int adId, std::string_view title, std::string_view description);
+
+    // Every query word must occur in the advert, either exactly or as the
+    // prefix of an indexed word. Hits are ranked by weighted term frequency
+    // (title words count double, prefix matches half) decayed by age.
+    //
+    // A query word of three characters or more expands to every indexed word
+    // it starts, with no cap, so the work grows with the postings of all
+    // those words; a shorter one matches only itself.
+    [[nodiscard]] std::vector<Hit> search(std::string_view query, size_t limit, std::time_t now) const;
+
+private:
+    struct Posting
+    {
+        int adId = 0;
+        uint16_t weight = 0; // 0 marks a removed advert until the list is compacted
+    };
+
+    struct PostingList
+    {
+        std::vector<Posting> postings; // sorted by adId
+        size_t dead = 0;
+    };
+
+    struct TermMatch
+    {
+        const PostingList *list = nullptr;
+        double factor = 1.0;
+    };
+
+    [[nodiscard]] std::vector<TermMatch> matchTerm(const std::string &word) const;
+    // Calls fn(adId, score) for every advert in any of the lists, in id
+    // order, with its weights summed over them; removed adverts are skipped.
+    template <typename Fn>
+    static void mergePostings(const std::vector<TermMatch> &matches, Fn &&fn);
+
+    mutable std::shared_mutex mutex_;
+    std::map<std::string, PostingList, std::less<>> terms_;
+    std::vector<std::time_t> createdAt_; // indexed by advert id
+};
@@ -0,0 +1,943 @@
+#include "server.hpp"
+
+#include "arena.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    constexpr int kBacklogSize = 1024;
+    constexpr int kBufferSize = 8192;
+    constexpr int kMaxEvents = 256;
+    constexpr int kSweepIntervalMs = 1000;
+    // An event stream whose client falls this far behind is closed; the
+    // browser reconnects and reloads instead of us buffering without end.
+    constexpr size_t kMaxStreamBacklog = 1 << 20;
+    // Comment lines sent on idle streams, so proxies keep them and dead
+    // peers are noticed.
+    constexpr auto kHeartbeatInterval = std::chrono::seconds(15);
+    constexpr size_t kMaxEventIovecs = 64;
+
+    using Clock = std::chrono::steady_clock;
+
+    int createListener(uint16_t port, bool reusePort)
+    {
+        int sock = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0)
+        {
+            std::perror("socket");
+            return -1;
+        }
+
+        int opt = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+            (reusePort && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0))
+        {
+            std::perror("setsockopt");
+            ::close(sock);
+            return -1;
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+
+        if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            std::perror("bind");
+            ::close(sock);
+            return -1;
+        }
+
+        if (listen(sock, kBacklogSize) < 0)
+        {
+            std::perror("listen");
+            ::close(sock);
+            return -1;
+        }
+        return sock;
+    }
+
+    void setSimpleResponse(HttpResponse &response, int status, const char *body)
+    {
+        response.status = status;
+        response.body = body;
+        if (status == 503)
+        {
+            response.setHeader("Retry-After", "1");
+        }
+    }
+}
+
+// One request and its response. Everything in it is allocated from the
+// connection's arena, and it is destroyed before the arena is rewound.
+struct Exchange
+{
+    explicit Exchange(std::pmr::memory_resource *resource) : request(resource), response(resource), head(resource) {}
+
+    HttpRequest request;
+    HttpResponse response;
+    std::pmr::string head;
+};
+
+// A response ready to be written: the head and an in-memory body go out
+// together as iovecs, a file body follows with sendfile(2). Views the
+// exchange, which stays alive until the response has been written.
+struct OutgoingResponse
+{
+    OutgoingResponse() = default;
+    OutgoingResponse(Exchange &exchange, bool keepAlive)
+    {
+        exchange.head = serializeHead(exchange.response, keepAlive);
+        head = exchange.head;
+        body = exchange.response.body;
+        sharedBody = std::move(exchange.response.sharedBody);
+        file = std::move(exchange.response.file);
+        eventStream = exchange.response.eventStream;
+    }
+
+    [[nodiscard]] bool empty() const { return head.empty(); }
+    [[nodiscard]] std::string_view memoryBody() const { return sharedBody ? std::string_view(*sharedBody) : body; }
+    [[nodiscard]] size_t memorySize() const { return head.size() + memoryBody().size(); }
+    [[nodiscard]] size_t size() const { return memorySize() + (file ? file->size : 0); }
+
+    std::string_view head;
+    std::string_view body;
+    std::shared_ptr<const std::string> sharedBody;
+    std::shared_ptr<const FileBody> file;
+    std::optional<uint64_t> eventStream;
+};
+
+WorkerPool::WorkerPool(unsigned threads, size_t maxQueueDepth)
+    : maxQueueDepth_(maxQueueDepth)
+{
+    threads_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back([this]()
+                              { workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+bool WorkerPool::tryPost(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_ || queue_.size() >= maxQueueDepth_)
+        {
+            return false;
+        }
+        queue_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void WorkerPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this]()
+                     { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
+
+struct Connection
+{
+    int fd = -1;
+    // Client address from accept, in host byte order.
+    uint32_t remoteAddress = 0;
+    std::string in;
+    HttpParser parser;
+    // Declared before what it backs, so it is destroyed last.
+    RequestArena arena;
+    std::optional<Exchange> exchange;
+    OutgoingResponse out;
+    size_t outOffset = 0;
+    // A request from this connection is being handled by a worker; reading is
+    // paused until its response has been queued.
+    bool inFlight = false;
+    bool closeAfterWrite = false;
+    bool peerClosed = false;
+    bool closed = false;
+    unsigned requestsServed = 0;
+    Clock::time_point lastActive = Clock::now();
+    // Keeps the connection alive while a worker has it. The task then only
+    // needs a raw pointer and fits in std::function without an allocation.
+    std::shared_ptr<Connection> pinned;
+    // Set once the connection has become an event stream: the subscriber
+    // key, its place in the loop's list for that key, and published events
+    // still to be written (shared with every other stream that gets them).
+    std::optional<uint64_t> streamKey;
+    size_t streamSlot = 0;
+    std::vector<std::shared_ptr<const std::string>> events;
+    size_t eventOffset = 0;
+    size_t eventBytes = 0;
+
+    // Starts over with an empty exchange once the previous response is gone.
+    Exchange &beginExchange()
+    {
+        exchange.reset();
+        arena.reset();
+        return exchange.emplace(&arena);
+    }
+};
+
+class EventLoop
+{
+public:
+    EventLoop(HttpServer &server, int listenFd);
+    ~EventLoop();
+
+    bool init();
+    void run();
+
+    // Called from worker threads to hand a serialized response back to the loop.
+    void complete(std::shared_ptr<Connection> conn, OutgoingResponse response, bool keepAlive);
+    // Called from any thread; the event goes out on the next wakeup.
+    void publish(std::shared_ptr<const std::string> event, std::optional<uint64_t> subscriber);
+
+private:
+    void acceptConnections();
+    void onReadable(const std::shared_ptr<Connection> &conn);
+    void processInput(const std::shared_ptr<Connection> &conn);
+    void dispatch(const std::shared_ptr<Connection> &conn);
+    void queueSimpleResponse(const std::shared_ptr<Connection> &conn, int status, const char *body);
+    void queueResponse(const std::shared_ptr<Connection> &conn, OutgoingResponse response, bool keepAlive);
+    void flush(const std::shared_ptr<Connection> &conn);
+    void closeConnection(const std::shared_ptr<Connection> &conn);
+    void drainCompletions();
+    void closeIdleConnections();
+
+    void openStream(const std::shared_ptr<Connection> &conn, uint64_t key);
+    void closeStream(const std::shared_ptr<Connection> &conn);
+    void deliver(const std::shared_ptr<const std::string> &event, std::optional<uint64_t> subscriber);
+    void enqueueEvent(const std::shared_ptr<Connection> &conn, const std::shared_ptr<const std::string> &event);
+    void flushEvents(const std::shared_ptr<Connection> &conn);
+
+    HttpServer &server_;
+    int listenFd_;
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+    Clock::time_point lastSweep_ = Clock::now();
+
+    struct Completion
+    {
+        std::shared_ptr<Connection> conn;
+        OutgoingResponse response;
+        bool keepAlive;
+    };
+    struct Publication
+    {
+        std::shared_ptr<const std::string> event;
+        std::optional<uint64_t> subscriber;
+    };
+    std::mutex completionMutex_;
+    std::vector<Completion> completions_;
+    std::vector<Publication> publications_;
+    // Swapped with completions_ and publications_ when draining, so none reallocates.
+    std::vector<Completion> ready_;
+    std::vector<Publication> delivering_;
+
+    // Event streams on this loop by subscriber key.
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<Connection>>> streams_;
+    std::vector<std::shared_ptr<Connection>> deliveryTargets_;
+    const std::shared_ptr<const std::string> heartbeat_ = std::make_shared<const std::string>(": ping\n\n");
+    Clock::time_point lastHeartbeat_ = Clock::now();
+};
+
+EventLoop::EventLoop(HttpServer &server, int listenFd)
+    : server_(server), listenFd_(listenFd)
+{
+}
+
+EventLoop::~EventLoop()
+{
+    for (auto &[fd, conn] : connections_)
+    {
+        ::close(fd);
+        conn->closed = true;
+    }
+    if (wakeFd_ >= 0)
+    {
+        ::close(wakeFd_);
+    }
+    if (epollFd_ >= 0)
+    {
+        ::close(epollFd_);
+    }
+}
+
+bool EventLoop::init()
+{
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0)
+    {
+        std::perror("epoll");
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd_;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev) < 0)
+    {
+        std::perror("epoll_ctl");
+        return false;
+    }
+
+    // A listener shared between loops is registered exclusively so a new
+    // connection wakes only one of them.
+    ev.events = server_.options_.reusePort ? EPOLLIN : (EPOLLIN | EPOLLEXCLUSIVE);
+    ev.data.fd = listenFd_;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev) < 0)
+    {
+        std::perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::run()
+{
+    epoll_event events[kMaxEvents];
+    while (!server_.stopping_.load(std::memory_order_relaxed))
+    {
+        const int count = epoll_wait(epollFd_, events, kMaxEvents, kSweepIntervalMs);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::perror("epoll_wait");
+            return;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            const int fd = events[i].data.fd;
+            const uint32_t mask = events[i].events;
+            if (fd == listenFd_)
+            {
+                acceptConnections();
+                continue;
+            }
+            if (fd == wakeFd_)
+            {
+                drainCompletions();
+                continue;
+            }
+
+            auto it = connections_.find(fd);
+            if (it == connections_.end())
+            {
+                continue;
+            }
+            const auto conn = it->second;
+            if (mask & EPOLLERR)
+            {
+                closeConnection(conn);
+                continue;
+            }
+            if (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+            {
+                onReadable(conn);
+            }
+            if ((mask & EPOLLOUT) && !conn->closed)
+            {
+                if (!conn->out.empty())
+                {
+                    flush(conn);
+                }
+                else if (!conn->events.empty())
+                {
+                    flushEvents(conn);
+                }
+            }
+        }
+
+        if (Clock::now() - lastSweep_ >= std::chrono::milliseconds(kSweepIntervalMs))
+        {
+            closeIdleConnections();
+        }
+    }
+}
+
+void EventLoop::complete(std::shared_ptr<Connection> conn, OutgoingResponse response, bool keepAlive)
+{
+    {
+        std::lock_guard lock(completionMutex_);
+        completions_.push_back({std::move(conn), std::move(response), keepAlive});
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto written = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void EventLoop::publish(std::shared_ptr<const std::string> event, std::optional<uint64_t> subscriber)
+{
+    {
+        std::lock_guard lock(completionMutex_);
+        publications_.push_back({std::move(event), subscriber});
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto written = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void EventLoop::acceptConnections()
+{
+    while (true)
+    {
+        sockaddr_in clientAddr{};
+        socklen_t len = sizeof(clientAddr);
+        int clientSock = accept4(listenFd_, reinterpret_cast<sockaddr *>(&clientAddr), &len,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSock < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                std::perror("accept");
+            }
+            return;
+        }
+
+        auto conn = std::make_shared<Connection>();
+        conn->fd = clientSock;
+        conn->remoteAddress = ntohl(clientAddr.sin_addr.s_addr);
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = clientSock;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientSock, &ev) < 0)
+        {
+            std::perror("epoll_ctl");
+            ::close(clientSock);
+            continue;
+        }
+        connections_.emplace(clientSock, std::move(conn));
+        server_.activeConnections_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void EventLoop::onReadable(const std::shared_ptr<Connection> &conn)
+{
+    if (conn->inFlight || conn->closed)
+    {
+        return;
+    }
+
+    char buffer[kBufferSize];
+    if (conn->streamKey)
+    {
+        // Nothing more is parsed on a stream; reading only tells us when it ends.
+        while (true)
+        {
+            const ssize_t received = ::recv(conn->fd, buffer, sizeof(buffer), 0);
+            if (received > 0 || (received < 0 && errno == EINTR))
+            {
+                continue;
+            }
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            {
+                closeConnection(conn);
+            }
+            return;
+        }
+    }
+
+    // A request left buffered behind the previous one goes first. Otherwise
+    // read only until a complete request has been handed on: pipelined data
+    // behind it stays in the socket and is read once its response has been
+    // written (flush() comes back here).
+    processInput(conn);
+    while (!conn->closed && !conn->inFlight && conn->out.empty())
+    {
+        const ssize_t received = ::recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (received > 0)
+        {
+            conn->in.append(buffer, static_cast<size_t>(received));
+            conn->lastActive = Clock::now();
+            processInput(conn);
+            continue;
+        }
+        if (received == 0)
+        {
+            conn->peerClosed = true;
+            break;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        closeConnection(conn);
+        return;
+    }
+
+    if (!conn->closed && conn->peerClosed && !conn->inFlight && conn->out.empty())
+    {
+        closeConnection(conn);
+    }
+}
+
+void EventLoop::processInput(const std::shared_ptr<Connection> &conn)
+{
+    if (conn->inFlight || !conn->out.empty())
+    {
+        return;
+    }
+
+    // Nothing refers to the previous exchange any more: its response has
+    // been written and the worker let go of it before completing.
+    auto &exchange = conn->beginExchange();
+    switch (conn->parser.parse(conn->in, exchange.request))
+    {
+    case ParseStatus::Incomplete:
+        if (conn->in.size() > kMaxRequestBytes)
+        {
+            queueSimpleResponse(conn, 413, R"({"error":"Request too large"})");
+        }
+        return;
+    case ParseStatus::Invalid:
+        queueSimpleResponse(conn, 400, R"({"error":"Malformed request"})");
+        return;
+    case ParseStatus::TooLarge:
+        queueSimpleResponse(conn, 413, R"({"error":"Request too large"})");
+        return;
+    case ParseStatus::Complete:
+        // The request views conn->in, which stays untouched until the
+        // response comes back (reads are paused while it is in flight).
+        exchange.request.remoteAddress = conn->remoteAddress;
+        dispatch(conn);
+        return;
+    }
+}
+
+void EventLoop::dispatch(const std::shared_ptr<Connection> &conn)
+{
+    conn->inFlight = true;
+    ++conn->requestsServed;
+    conn->pinned = conn;
+    auto task = [this, connection = conn.get()]()
+    {
+        auto &exchange = *connection->exchange;
+        try
+        {
+            server_.handler_(exchange.request, exchange.response);
+        }
+        catch (const std::exception &)
+        {
+            exchange.response = HttpResponse(&connection->arena);
+            exchange.response.status = 500;
+            exchange.response.body = R"({"error":"Internal server error"})";
+        }
+        // An event stream outlives the usual per-connection request limit.
+        const bool keepAlive = exchange.response.eventStream ||
+                               (wantsKeepAlive(exchange.request) &&
+                                connection->requestsServed < server_.options_.maxRequestsPerConnection);
+        // The connection belongs to the event loop again from here on.
+        complete(std::move(connection->pinned), OutgoingResponse(exchange, keepAlive), keepAlive);
+    };
+
+    if (!server_.pool_.tryPost(std::move(task)))
+    {
+        conn->inFlight = false;
+        conn->pinned.reset();
+        queueSimpleResponse(conn, 503, R"({"error":"Server is busy"})");
+    }
+}
+
+void EventLoop::queueSimpleResponse(const std::shared_ptr<Connection> &conn, int status, const char *body)
+{
+    auto &exchange = *conn->exchange;
+    exchange.response = HttpResponse(&conn->arena);
+    setSimpleResponse(exchange.response, status, body);
+    queueResponse(conn, OutgoingResponse(exchange, false), false);
+}
+
+void EventLoop::queueResponse(const std::shared_ptr<Connection> &conn, OutgoingResponse response, bool keepAlive)
+{
+    if (response.eventStream)
+    {
+        openStream(conn, *response.eventStream);
+    }
+    conn->out = std::move(response);
+    conn->outOffset = 0;
+    conn->closeAfterWrite = !keepAlive;
+    flush(conn);
+}
+
+void EventLoop::flush(const std::shared_ptr<Connection> &conn)
+{
+    auto &out = conn->out;
+    const size_t total = out.size();
+    while (conn->outOffset < total)
+    {
+        ssize_t result;
+        if (conn->outOffset < out.memorySize())
+        {
+            const auto body = out.memoryBody();
+            iovec iov[2];
+            size_t count = 0;
+            if (conn->outOffset < out.head.size())
+            {
+                iov[count++] = {const_cast<char *>(out.head.data()) + conn->outOffset, out.head.size() - conn->outOffset};
+            }
+            const size_t bodySent = conn->outOffset > out.head.size() ? conn->outOffset - out.head.size() : 0;
+            if (bodySent < body.size())
+            {
+                iov[count++] = {const_cast<char *>(body.data()) + bodySent, body.size() - bodySent};
+            }
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            // With a file to follow, let the kernel merge the head into its first segment.
+            result = ::sendmsg(conn->fd, &message, MSG_NOSIGNAL | (out.file ? MSG_MORE : 0));
+        }
+        else
+        {
+            off_t fileOffset = static_cast<off_t>(conn->outOffset - out.memorySize());
+            result = ::sendfile(conn->fd, out.file->fd, &fileOffset, total - conn->outOffset);
+        }
+        if (result > 0)
+        {
+            conn->outOffset += static_cast<size_t>(result);
+            continue;
+        }
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return; // resumed on EPOLLOUT
+        }
+        closeConnection(conn);
+        return;
+    }
+
+    conn->out = OutgoingResponse{};
+    conn->outOffset = 0;
+    conn->lastActive = Clock::now();
+    if (conn->closeAfterWrite)
+    {
+        closeConnection(conn);
+        return;
+    }
+    if (conn->streamKey)
+    {
+        // The head is out and no request follows: give the parsing memory
+        // back, as a stream may stay open for hours.
+        conn->exchange.reset();
+        conn->arena.release();
+        conn->in = std::string();
+        flushEvents(conn);
+        return;
+    }
+    // Edge-triggered: data that arrived while this response was pending has
+    // not been read yet, and earlier pipelined requests may already be buffered.
+    onReadable(conn);
+}
+
+void EventLoop::closeConnection(const std::shared_ptr<Connection> &conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    conn->closed = true;
+    if (conn->streamKey)
+    {
+        closeStream(conn);
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+    ::close(conn->fd);
+    connections_.erase(conn->fd);
+    server_.activeConnections_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EventLoop::drainCompletions()
+{
+    uint64_t value = 0;
+    while (::read(wakeFd_, &value, sizeof(value)) > 0)
+    {
+    }
+
+    {
+        std::lock_guard lock(completionMutex_);
+        ready_.swap(completions_);
+        delivering_.swap(publications_);
+    }
+    for (auto &completion : ready_)
+    {
+        const auto &conn = completion.conn;
+        conn->inFlight = false;
+        if (conn->closed)
+        {
+            continue;
+        }
+        // Drop the finished request; what remains is the next pipelined one.
+        conn->in.erase(0, conn->parser.consumed());
+        conn->parser.reset();
+        queueResponse(completion.conn, std::move(completion.response), completion.keepAlive);
+    }
+    ready_.clear();
+
+    for (const auto &publication : delivering_)
+    {
+        deliver(publication.event, publication.subscriber);
+    }
+    delivering_.clear();
+}
+
+void EventLoop::closeIdleConnections()
+{
+    const auto now = Clock::now();
+    lastSweep_ = now;
+    const auto timeout = std::chrono::seconds(server_.options_.idleTimeoutSeconds);
+
+    std::vector<std::shared_ptr<Connection>> expired;
+    for (const auto &[fd, conn] : connections_)
+    {
+        if (!conn->streamKey && !conn->inFlight && conn->out.empty() && now - conn->lastActive >= timeout)
+        {
+            expired.push_back(conn);
+        }
+    }
+    for (const auto &conn : expired)
+    {
+        closeConnection(conn);
+    }
+
+    if (now - lastHeartbeat_ >= kHeartbeatInterval)
+    {
+        lastHeartbeat_ = now;
+        deliver(heartbeat_, std::nullopt);
+    }
+}
+
+void EventLoop::openStream(const std::shared_ptr<Connection> &conn, uint64_t key)
+{
+    auto &streams = streams_[key];
+    conn->streamKey = key;
+    conn->streamSlot = streams.size();
+    streams.push_back(conn);
+    server_.eventStreams_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventLoop::closeStream(const std::shared_ptr<Connection> &conn)
+{
+    auto it = streams_.find(*conn->streamKey);
+    auto &streams = it->second;
+    // Swap with the last one so removal does not depend on the number of streams.
+    streams.back()->streamSlot = conn->streamSlot;
+    streams[conn->streamSlot] = std::move(streams.back());
+    streams.pop_back();
+    if (streams.empty())
+    {
+        streams_.erase(it);
+    }
+    conn->events.clear();
+    server_.eventStreams_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EventLoop::deliver(const std::shared_ptr<const std::string> &event, std::optional<uint64_t> subscriber)
+{
+    // Copied first: a stream that fails to take the event closes and leaves the list.
+    auto &targets = deliveryTargets_;
+    if (subscriber)
+    {
+        if (auto it = streams_.find(*subscriber); it != streams_.end())
+        {
+            targets.assign(it->second.begin(), it->second.end());
+        }
+    }
+    else
+    {
+        for (const auto &[key, streams] : streams_)
+        {
+            targets.insert(targets.end(), streams.begin(), streams.end());
+        }
+    }
+    for (const auto &conn : targets)
+    {
+        enqueueEvent(conn, event);
+    }
+    targets.clear();
+}
+
+void EventLoop::enqueueEvent(const std::shared_ptr<Connection> &conn, const std::shared_ptr<const std::string> &event)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    if (conn->eventBytes + event->size() > kMaxStreamBacklog)
+    {
+        closeConnection(conn);
+        return;
+    }
+    conn->events.push_back(event);
+    conn->eventBytes += event->size();
+    // Until the head is out, flush() owns the socket; it sends the events after it.
+    if (conn->out.empty() && conn->events.size() == 1)
+    {
+        flushEvents(conn);
+    }
+}
+
+void EventLoop::flushEvents(const std::shared_ptr<Connection> &conn)
+{
+    while (!conn->events.empty())
+    {
+        iovec iov[kMaxEventIovecs];
+        const size_t count = std::min(conn->events.size(), kMaxEventIovecs);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto &event = *conn->events[i];
+            const size_t skip = i == 0 ? conn->eventOffset : 0;
+            iov[i] = {const_cast<char *>(event.data()) + skip, event.size() - skip};
+        }
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        const ssize_t result = ::sendmsg(conn->fd, &message, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return; // resumed on EPOLLOUT
+        }
+        if (result <= 0)
+        {
+            closeConnection(conn);
+            return;
+        }
+
+        auto sent = static_cast<size_t>(result);
+        conn->eventBytes -= sent;
+        size_t done = 0;
+        while (done < count && sent >= conn->events[done]->size() - conn->eventOffset)
+        {
+            sent -= conn->events[done]->size() - conn->eventOffset;
+            conn->eventOffset = 0;
+            ++done;
+        }
+        conn->eventOffset += sent;
+        conn->events.erase(conn->events.begin(), conn->events.begin() + static_cast<std::ptrdiff_t>(done));
+    }
+    conn->lastActive = Clock::now();
+}
+
+HttpServer::HttpServer(ServerOptions options, Handler handler)
+    : options_(options),
+      handler_(std::move(handler)),
+      pool_(std::max(1u, options.workerThreads), std::max<size_t>(1, options.maxQueueDepth))
+{
+}
+
+void HttpServer::publish(std::string event, std::optional<uint64_t> subscriber)
+{
+    const auto shared = std::make_shared<const std::string>(std::move(event));
+    for (const auto &loop : loops_)
+    {
+        loop->publish(shared, subscriber);
+    }
+}
+
+HttpServer::~HttpServer()
+{
+    for (int fd : listeners_)
+    {
+        ::close(fd);
+    }
+}
+
+bool HttpServer::run()
+{
+    // sendfile(2) has no MSG_NOSIGNAL; a peer that went away must not kill us.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const unsigned ioThreads = std::max(1u, options_.ioThreads);
+    for (unsigned i = 0; i < ioThreads; ++i)
+    {
+        if (listeners_.empty() || options_.reusePort)
+        {
+            const int fd = createListener(options_.port, options_.reusePort);
+            if (fd < 0)
+            {
+                return false;
+            }
+            listeners_.push_back(fd);
+        }
+        auto loop = std::make_unique<EventLoop>(*this, listeners_.back());
+        if (!loop->init())
+        {
+            return false;
+        }
+        loops_.push_back(std::move(loop));
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < loops_.size(); ++i)
+    {
+        threads.emplace_back([loop = loops_[i].get()]()
+                             { loop->run(); });
+    }
+    loops_.front()->run();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return true;
+}
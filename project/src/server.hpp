@@ -0,0 +1,94 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ServerOptions
+{
+    uint16_t port = 8080;
+    unsigned ioThreads = 1;
+    unsigned workerThreads = 4;
+    // Requests waiting for a worker beyond this limit are answered with 503.
+    size_t maxQueueDepth = 1024;
+    // Give every I/O thread its own SO_REUSEPORT listener instead of sharing one.
+    bool reusePort = false;
+    // Keep-alive connections with no request in progress are closed after this.
+    unsigned idleTimeoutSeconds = 15;
+    // A connection is closed after serving this many requests.
+    unsigned maxRequestsPerConnection = 100;
+};
+
+class WorkerPool
+{
+public:
+    WorkerPool(unsigned threads, size_t maxQueueDepth);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Returns false without queueing when the pool is saturated.
+    bool tryPost(std::function<void()> task);
+
+private:
+    void workerLoop();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> queue_;
+    size_t maxQueueDepth_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+class EventLoop;
+
+class HttpServer
+{
+public:
+    using Handler = std::function<void(const HttpRequest &, HttpResponse &)>;
+
+    HttpServer(ServerOptions options, Handler handler);
+    ~HttpServer();
+
+    // Blocks serving requests; returns false if the listener could not be set up.
+    bool run();
+    // Makes run() return, from any thread. The event loops notice within a
+    // second; requests already with a worker are still answered.
+    void stop() { stopping_.store(true, std::memory_order_relaxed); }
+
+    // Sends `event` (complete text/event-stream frames) to the open event
+    // streams: all of them, or only those opened with `subscriber` as key.
+    // Callable from any thread while run() serves; each loop writes its own
+    // streams, so the caller never waits on a slow client.
+    void publish(std::string event, std::optional<uint64_t> subscriber = std::nullopt);
+
+    // Open client connections across all event loops.
+    [[nodiscard]] size_t activeConnections() const { return activeConnections_.load(std::memory_order_relaxed); }
+    // Connections among them that are event streams.
+    [[nodiscard]] size_t eventStreams() const { return eventStreams_.load(std::memory_order_relaxed); }
+
+private:
+    friend class EventLoop;
+
+    ServerOptions options_;
+    Handler handler_;
+    std::vector<int> listeners_;
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    std::atomic<size_t> activeConnections_{0};
+    std::atomic<size_t> eventStreams_{0};
+    std::atomic<bool> stopping_{false};
+    // Declared last so workers are joined before the loops they report back to.
+    WorkerPool pool_;
+};
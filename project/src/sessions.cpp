@@ -0,0 +1,461 @@
+#include "sessions.hpp"
+
+#include "random.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // How many live sessions an eviction compares; 16 gets close to true LRU.
+    constexpr size_t kEvictionSample = 16;
+
+    size_t tableCapacity(size_t maxSessions)
+    {
+        // At most half full with live sessions, so probes stay short.
+        size_t capacity = 16;
+        while (capacity < maxSessions * 2)
+        {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    // Byte -> its two hex digits, so encoding is one copy per byte.
+    constexpr auto kHexPairs = []()
+    {
+        constexpr char digits[] = "0123456789abcdef";
+        std::array<std::array<char, 2>, 256> pairs{};
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            pairs[i][0] = digits[i >> 4];
+            pairs[i][1] = digits[i & 0xF];
+        }
+        return pairs;
+    }();
+
+    // Character -> nibble value, or 0xFF for anything that is not a hex digit.
+    constexpr auto kHexValues = []()
+    {
+        std::array<uint8_t, 256> values{};
+        for (auto &value : values)
+        {
+            value = 0xFF;
+        }
+        for (int i = 0; i < 10; ++i)
+        {
+            values['0' + i] = static_cast<uint8_t>(i);
+        }
+        for (int i = 0; i < 6; ++i)
+        {
+            values['a' + i] = static_cast<uint8_t>(10 + i);
+            values['A' + i] = static_cast<uint8_t>(10 + i);
+        }
+        return values;
+    }();
+
+    constexpr uint64_t packStamp(uint32_t lastUsed, uint32_t generation)
+    {
+        return (uint64_t(lastUsed) << 32) | generation;
+    }
+}
+
+SessionToken SessionToken::generate()
+{
+    SessionToken token;
+    secureRandomBytes(token.words.data(), sizeof(token.words));
+    return token;
+}
+
+std::optional<SessionToken> SessionToken::parse(std::string_view hex)
+{
+    if (hex.size() != kHexSize)
+    {
+        return std::nullopt;
+    }
+    SessionToken token;
+    for (size_t w = 0; w < token.words.size(); ++w)
+    {
+        uint64_t word = 0;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const uint8_t nibble = kHexValues[static_cast<unsigned char>(hex[w * 16 + i])];
+            if (nibble > 0xF)
+            {
+                return std::nullopt;
+            }
+            word = (word << 4) | nibble;
+        }
+        token.words[w] = word;
+    }
+    return token;
+}
+
+std::string SessionToken::hex() const
+{
+    std::string hex(kHexSize, '\0');
+    char *out = hex.data();
+    for (uint64_t word : words)
+    {
+        for (int shift = 56; shift >= 0; shift -= 8, out += 2)
+        {
+            std::memcpy(out, kHexPairs[(word >> shift) & 0xFF].data(), 2);
+        }
+    }
+    return hex;
+}
+
+SessionStore::SessionStore(size_t maxSessions, std::chrono::seconds idleTtl)
+    : capacity_(tableCapacity(std::max<size_t>(1, maxSessions))),
+      maxSessions_(std::max<size_t>(1, maxSessions)),
+      idleTtl_(static_cast<uint32_t>(std::clamp<std::chrono::seconds::rep>(idleTtl.count(), 1, UINT32_MAX / 2))),
+      epoch_(std::chrono::steady_clock::now()),
+      slots_(new Slot[capacity_]),
+      serials_(new uint64_t[capacity_]()),
+      sampler_(std::random_device{}())
+{
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        auto &slot = slots_[i];
+        for (auto &word : slot.key)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+        slot.stamp.store(0, std::memory_order_relaxed);
+        slot.userId.store(0, std::memory_order_relaxed);
+        slot.state.store(kEmpty, std::memory_order_relaxed);
+    }
+}
+
+void SessionStore::setDropListener(DropListener listener)
+{
+    std::lock_guard lock(writeMutex_);
+    dropListener_ = std::move(listener);
+}
+
+size_t SessionStore::home(const SessionToken &token) const
+{
+    // Generated tokens are uniformly random already; the multiply only
+    // spreads hand-crafted ones that clients may present.
+    const uint64_t hash = (token.words[0] ^ token.words[1]) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash >> 32) & (capacity_ - 1);
+}
+
+bool SessionStore::expired(uint32_t lastUsed, uint32_t now) const
+{
+    // Seconds are truncated, so require a full TTL past the stamped second.
+    // Another reader may also have stamped a later second than `now`.
+    return now > lastUsed && now - lastUsed > idleTtl_;
+}
+
+uint32_t SessionStore::nowSeconds() const
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - epoch_).count());
+}
+
+SessionToken SessionStore::tokenAt(size_t slot) const
+{
+    SessionToken token;
+    for (size_t i = 0; i < kKeyWords; ++i)
+    {
+        token.words[i] = slots_[slot].key[i].load(std::memory_order_relaxed);
+    }
+    return token;
+}
+
+std::optional<int> SessionStore::find(const SessionToken &token) const
+{
+    const size_t start = home(token);
+
+    size_t found = capacity_;
+    int32_t userId = 0;
+    uint64_t stamp = 0;
+    while (true)
+    {
+        const uint64_t before = sequence_.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        found = capacity_;
+        for (size_t probe = 0, i = start; probe < capacity_; ++probe, i = (i + 1) & (capacity_ - 1))
+        {
+            const auto &slot = slots_[i];
+            const uint8_t state = slot.state.load(std::memory_order_relaxed);
+            if (state == kEmpty)
+            {
+                break;
+            }
+            if (state != kLive)
+            {
+                continue;
+            }
+            bool match = true;
+            for (size_t w = 0; w < kKeyWords && match; ++w)
+            {
+                match = slot.key[w].load(std::memory_order_relaxed) == token.words[w];
+            }
+            if (match)
+            {
+                found = i;
+                userId = slot.userId.load(std::memory_order_relaxed);
+                stamp = slot.stamp.load(std::memory_order_relaxed);
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == before)
+        {
+            break;
+        }
+    }
+    if (found == capacity_)
+    {
+        return std::nullopt;
+    }
+
+    const uint32_t now = nowSeconds();
+    const auto lastUsed = static_cast<uint32_t>(stamp >> 32);
+    if (expired(lastUsed, now))
+    {
+        return std::nullopt;
+    }
+    // At most one write per session per second, so busy sessions do not
+    // bounce the cache line between cores on every request.
+    if (lastUsed != now)
+    {
+        slots_[found].stamp.compare_exchange_strong(stamp, packStamp(now, static_cast<uint32_t>(stamp)),
+                                                    std::memory_order_relaxed);
+    }
+    return userId;
+}
+
+void SessionStore::put(const SessionToken &token, int userId)
+{
+    std::lock_guard lock(writeMutex_);
+    const uint32_t now = nowSeconds();
+    expire(now);
+
+    if (const auto existing = locate(token))
+    {
+        beginWrite();
+        writeSlot(*existing, token, userId, now);
+        endWrite();
+    }
+    else
+    {
+        if (live_.load(std::memory_order_relaxed) >= maxSessions_)
+        {
+            evictOne();
+        }
+        if (live_.load(std::memory_order_relaxed) + deleted_ >= capacity_ / 4 * 3)
+        {
+            rebuild();
+        }
+        size_t slot = home(token);
+        while (slots_[slot].state.load(std::memory_order_relaxed) == kLive)
+        {
+            slot = (slot + 1) & (capacity_ - 1);
+        }
+        if (slots_[slot].state.load(std::memory_order_relaxed) == kDeleted)
+        {
+            --deleted_;
+        }
+        beginWrite();
+        writeSlot(slot, token, userId, now);
+        endWrite();
+        live_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const size_t slot = *locate(token);
+    serials_[slot] = nextSerial_++;
+    expiries_.schedule(uint64_t(now) + idleTtl_ + 1, Expiry{token, serials_[slot]});
+}
+
+bool SessionStore::erase(const SessionToken &token)
+{
+    std::lock_guard lock(writeMutex_);
+    const auto slot = locate(token);
+    if (slot)
+    {
+        beginWrite();
+        removeSlot(*slot);
+        endWrite();
+    }
+    expire(nowSeconds());
+    return slot.has_value();
+}
+
+std::optional<size_t> SessionStore::locate(const SessionToken &token) const
+{
+    for (size_t probe = 0, i = home(token); probe < capacity_; ++probe, i = (i + 1) & (capacity_ - 1))
+    {
+        const auto &slot = slots_[i];
+        const uint8_t state = slot.state.load(std::memory_order_relaxed);
+        if (state == kEmpty)
+        {
+            break;
+        }
+        if (state != kLive)
+        {
+            continue;
+        }
+        bool match = true;
+        for (size_t w = 0; w < kKeyWords && match; ++w)
+        {
+            match = slot.key[w].load(std::memory_order_relaxed) == token.words[w];
+        }
+        if (match)
+        {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void SessionStore::beginWrite()
+{
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SessionStore::endWrite()
+{
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void SessionStore::writeSlot(size_t index, const SessionToken &token, int userId, uint32_t lastUsed)
+{
+    auto &slot = slots_[index];
+    for (size_t w = 0; w < kKeyWords; ++w)
+    {
+        slot.key[w].store(token.words[w], std::memory_order_relaxed);
+    }
+    const auto generation = static_cast<uint32_t>(slot.stamp.load(std::memory_order_relaxed)) + 1;
+    slot.stamp.store(packStamp(lastUsed, generation), std::memory_order_relaxed);
+    slot.userId.store(userId, std::memory_order_relaxed);
+    slot.state.store(kLive, std::memory_order_relaxed);
+}
+
+void SessionStore::removeSlot(size_t index)
+{
+    auto &slot = slots_[index];
+    const auto generation = static_cast<uint32_t>(slot.stamp.load(std::memory_order_relaxed)) + 1;
+    slot.stamp.store(packStamp(0, generation), std::memory_order_relaxed);
+    slot.state.store(kDeleted, std::memory_order_relaxed);
+    serials_[index] = 0;
+    live_.fetch_sub(1, std::memory_order_relaxed);
+    ++deleted_;
+}
+
+void SessionStore::drop(size_t slot)
+{
+    const SessionToken token = tokenAt(slot);
+    beginWrite();
+    removeSlot(slot);
+    endWrite();
+    if (dropListener_)
+    {
+        dropListener_(token);
+    }
+}
+
+void SessionStore::expire(uint32_t now)
+{
+    expiries_.advance(now, [this, now](Expiry &expiry)
+                      {
+        const auto slot = locate(expiry.token);
+        if (!slot || serials_[*slot] != expiry.serial)
+        {
+            return; // logged out, evicted or logged in again since
+        }
+        const auto lastUsed = static_cast<uint32_t>(slots_[*slot].stamp.load(std::memory_order_relaxed) >> 32);
+        if (expired(lastUsed, now))
+        {
+            drop(*slot);
+        }
+        else
+        {
+            // Used since it was scheduled; check again when the new idle period ends.
+            expiries_.schedule(uint64_t(lastUsed) + idleTtl_ + 1, std::move(expiry));
+        } });
+}
+
+void SessionStore::evictOne()
+{
+    size_t victim = capacity_;
+    uint32_t oldest = std::numeric_limits<uint32_t>::max();
+    std::uniform_int_distribution<size_t> pick(0, capacity_ - 1);
+    for (size_t sampled = 0; sampled < kEvictionSample;)
+    {
+        const size_t slot = pick(sampler_);
+        if (slots_[slot].state.load(std::memory_order_relaxed) != kLive)
+        {
+            continue;
+        }
+        ++sampled;
+        const auto lastUsed = static_cast<uint32_t>(slots_[slot].stamp.load(std::memory_order_relaxed) >> 32);
+        if (lastUsed < oldest)
+        {
+            oldest = lastUsed;
+            victim = slot;
+        }
+    }
+    drop(victim);
+}
+
+void SessionStore::rebuild()
+{
+    // Too many tombstones make misses probe far; re-insert the live sessions
+    // into a clean table. Readers retry until the new layout is complete.
+    struct Entry
+    {
+        SessionToken token;
+        int32_t userId;
+        uint64_t stamp;
+        uint64_t serial;
+    };
+    std::vector<Entry> entries;
+    entries.reserve(live_.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        const auto &slot = slots_[i];
+        if (slot.state.load(std::memory_order_relaxed) != kLive)
+        {
+            continue;
+        }
+        Entry entry{};
+        entry.token = tokenAt(i);
+        entry.userId = slot.userId.load(std::memory_order_relaxed);
+        entry.stamp = slot.stamp.load(std::memory_order_relaxed);
+        entry.serial = serials_[i];
+        entries.push_back(entry);
+    }
+
+    beginWrite();
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        auto &slot = slots_[i];
+        slot.stamp.store(packStamp(0, static_cast<uint32_t>(slot.stamp.load(std::memory_order_relaxed)) + 1),
+                         std::memory_order_relaxed);
+        slot.state.store(kEmpty, std::memory_order_relaxed);
+        serials_[i] = 0;
+    }
+    for (const auto &entry : entries)
+    {
+        size_t slot = home(entry.token);
+        while (slots_[slot].state.load(std::memory_order_relaxed) == kLive)
+        {
+            slot = (slot + 1) & (capacity_ - 1);
+        }
+        writeSlot(slot, entry.token, entry.userId, static_cast<uint32_t>(entry.stamp >> 32));
+        serials_[slot] = entry.serial;
+    }
+    endWrite();
+    deleted_ = 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "timing_wheel.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+// A 128-bit bearer token. Clients see it as 32 lowercase hex digits; the
+// store keeps the two binary words.
+struct SessionToken
+{
+    std::array<uint64_t, 2> words{};
+
+    static constexpr size_t kHexSize = 32;
+
+    // A fresh token from the CSPRNG.
+    static SessionToken generate();
+    // Empty unless `hex` is exactly kHexSize hex digits.
+    static std::optional<SessionToken> parse(std::string_view hex);
+    [[nodiscard]] std::string hex() const;
+
+    bool operator==(const SessionToken &other) const { return words == other.words; }
+};
+
+// Bearer tokens and the users they belong to.
+//
+// Lookups run on every authenticated request and take no lock: the table is
+// a fixed-size open-addressing array of atomics guarded by a sequence
+// counter, so a reader just retries in the rare case that a login or logout
+// changed it mid-probe. Writers serialize on a mutex.
+//
+// A session expires after `idleTtl` without use; a timing wheel reclaims the
+// slots of expired sessions. When `maxSessions` are live, a login evicts the
+// least recently used of a random sample of sessions.
+class SessionStore
+{
+public:
+    // Called under the store's lock with each session that expires or is
+    // evicted, so the removal can be journaled in order with the others.
+    using DropListener = std::function<void(const SessionToken &token)>;
+
+    explicit SessionStore(size_t maxSessions = 100000, std::chrono::seconds idleTtl = std::chrono::hours(24 * 7));
+
+    SessionStore(const SessionStore &) = delete;
+    SessionStore &operator=(const SessionStore &) = delete;
+
+    void setDropListener(DropListener listener);
+
+    void put(const SessionToken &token, int userId);
+    [[nodiscard]] std::optional<int> find(const SessionToken &token) const;
+    // True if the token named a live session, which is now gone.
+    bool erase(const SessionToken &token);
+    [[nodiscard]] size_t size() const { return live_.load(std::memory_order_relaxed); }
+
+    template <typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        std::lock_guard lock(writeMutex_);
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            if (slots_[i].state.load(std::memory_order_relaxed) == kLive)
+            {
+                fn(tokenAt(i), slots_[i].userId.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kKeyWords = std::tuple_size_v<decltype(SessionToken::words)>;
+    static constexpr uint8_t kEmpty = 0;
+    static constexpr uint8_t kLive = 1;
+    static constexpr uint8_t kDeleted = 2;
+
+    // Every field is atomic because readers may look at a slot while a writer
+    // is changing it; the sequence counter tells them to discard what they saw.
+    struct Slot
+    {
+        std::atomic<uint64_t> key[kKeyWords];
+        // Last use in store seconds (high half) and a generation that changes
+        // whenever the slot is rewritten (low half), so a reader's touch can
+        // never land on a session other than the one it found.
+        std::atomic<uint64_t> stamp;
+        std::atomic<int32_t> userId;
+        std::atomic<uint8_t> state;
+    };
+
+    struct Expiry
+    {
+        SessionToken token;
+        uint64_t serial;
+    };
+
+    [[nodiscard]] size_t home(const SessionToken &token) const;
+    [[nodiscard]] uint32_t nowSeconds() const;
+    [[nodiscard]] bool expired(uint32_t lastUsed, uint32_t now) const;
+    [[nodiscard]] SessionToken tokenAt(size_t slot) const;
+
+    // Writer side; call with writeMutex_ held.
+    [[nodiscard]] std::optional<size_t> locate(const SessionToken &token) const;
+    void beginWrite();
+    void endWrite();
+    void writeSlot(size_t slot, const SessionToken &token, int userId, uint32_t lastUsed);
+    void removeSlot(size_t slot);
+    void drop(size_t slot);
+    void expire(uint32_t now);
+    void evictOne();
+    void rebuild();
+
+    const size_t capacity_;
+    const size_t maxSessions_;
+    const uint32_t idleTtl_;
+    const std::chrono::steady_clock::time_point epoch_;
+
+    std::unique_ptr<Slot[]> slots_;
+    // Odd while a writer is changing slots_.
+    std::atomic<uint64_t> sequence_{0};
+    std::atomic<size_t> live_{0};
+
+    mutable std::mutex writeMutex_;
+    size_t deleted_ = 0;
+    uint64_t nextSerial_ = 1;
+    std::unique_ptr<uint64_t[]> serials_; // per slot, matches the Expiry that owns it
+    TimingWheel<Expiry> expiries_;
+    std::minstd_rand sampler_;
+    DropListener dropListener_;
+};
@@ -0,0 +1,352 @@
+#include "snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr char kMagic[8] = {'B', 'B', 'S', 'N', 'A', 'P', '\0', '\1'};
+    constexpr uint32_t kVersion = 1;
+
+    enum Column : uint32_t
+    {
+        UserIds,
+        UserNames,
+        UserEmails,
+        UserPasswordHashes,
+        AdvertIds,
+        AdvertOwnerIds,
+        AdvertPrices,
+        AdvertCreatedAt,
+        AdvertTitles,
+        AdvertDescriptions,
+        ResponseAdvertIds,
+        ResponseUserIds,
+        SessionTokens,
+        SessionUserIds,
+        StringTable,
+        kColumnCount,
+    };
+
+    constexpr size_t kAlignment = 8;
+
+    size_t alignUp(size_t value)
+    {
+        return (value + kAlignment - 1) & ~(kAlignment - 1);
+    }
+
+    bool writeAll(int fd, const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            const ssize_t written = ::write(fd, bytes, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // A rename is only durable once the directory holding it is synced.
+    bool syncParentDirectory(const std::filesystem::path &path)
+    {
+        const auto directory = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+        const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        const bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+}
+
+struct SnapshotFile::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t userCount;
+    uint64_t advertCount;
+    uint64_t responseCount;
+    uint64_t sessionCount;
+    int32_t nextUserId;
+    int32_t nextAdvertId;
+    uint64_t stringTableSize;
+    uint64_t columnOffsets[kColumnCount];
+};
+
+struct SnapshotFile::StringRef
+{
+    uint64_t offset;
+    uint64_t length;
+};
+
+std::unique_ptr<SnapshotFile> SnapshotFile::open(const std::filesystem::path &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::perror(path.c_str());
+        return nullptr;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) < 0 || info.st_size < static_cast<off_t>(sizeof(Header)))
+    {
+        std::cerr << path << ": not a snapshot" << std::endl;
+        ::close(fd);
+        return nullptr;
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::perror("mmap");
+        return nullptr;
+    }
+    // Columns are read front to back while loading.
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+    std::unique_ptr<SnapshotFile> file(new SnapshotFile(static_cast<const char *>(mapping), size));
+    if (!file->validate())
+    {
+        std::cerr << path << ": corrupt or incompatible snapshot" << std::endl;
+        return nullptr;
+    }
+    return file;
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    ::munmap(const_cast<char *>(data_), size_);
+}
+
+const SnapshotFile::Header &SnapshotFile::header() const
+{
+    return *reinterpret_cast<const Header *>(data_);
+}
+
+template <typename T>
+const T *SnapshotFile::column(size_t index) const
+{
+    return reinterpret_cast<const T *>(data_ + header().columnOffsets[index]);
+}
+
+std::string_view SnapshotFile::string(const StringRef &ref) const
+{
+    return {column<char>(StringTable) + ref.offset, static_cast<size_t>(ref.length)};
+}
+
+bool SnapshotFile::validate() const
+{
+    const auto &h = header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.columnCount != kColumnCount)
+    {
+        return false;
+    }
+
+    const uint64_t rows[kColumnCount] = {
+        h.userCount, h.userCount, h.userCount, h.userCount,
+        h.advertCount, h.advertCount, h.advertCount, h.advertCount, h.advertCount, h.advertCount,
+        h.responseCount, h.responseCount,
+        h.sessionCount, h.sessionCount,
+        h.stringTableSize};
+    const size_t widths[kColumnCount] = {
+        sizeof(int32_t), sizeof(StringRef), sizeof(StringRef), sizeof(StringRef),
+        sizeof(int32_t), sizeof(int32_t), sizeof(double), sizeof(int64_t), sizeof(StringRef), sizeof(StringRef),
+        sizeof(int32_t), sizeof(int32_t),
+        sizeof(StringRef), sizeof(int32_t),
+        1};
+    for (size_t i = 0; i < kColumnCount; ++i)
+    {
+        const uint64_t offset = h.columnOffsets[i];
+        if (offset % kAlignment != 0 || offset < sizeof(Header) || offset > size_ ||
+            rows[i] > (size_ - offset) / widths[i])
+        {
+            return false;
+        }
+    }
+
+    const auto refsInBounds = [&](Column index, uint64_t count)
+    {
+        const auto *refs = column<StringRef>(index);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            if (refs[i].offset > h.stringTableSize || refs[i].length > h.stringTableSize - refs[i].offset)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    return refsInBounds(UserNames, h.userCount) && refsInBounds(UserEmails, h.userCount) &&
+           refsInBounds(UserPasswordHashes, h.userCount) && refsInBounds(AdvertTitles, h.advertCount) &&
+           refsInBounds(AdvertDescriptions, h.advertCount) && refsInBounds(SessionTokens, h.sessionCount);
+}
+
+size_t SnapshotFile::userCount() const { return header().userCount; }
+size_t SnapshotFile::advertCount() const { return header().advertCount; }
+size_t SnapshotFile::responseCount() const { return header().responseCount; }
+size_t SnapshotFile::sessionCount() const { return header().sessionCount; }
+int SnapshotFile::nextUserId() const { return header().nextUserId; }
+int SnapshotFile::nextAdvertId() const { return header().nextAdvertId; }
+
+SnapshotFile::UserView SnapshotFile::user(size_t index) const
+{
+    return {column<int32_t>(UserIds)[index],
+            string(column<StringRef>(UserNames)[index]),
+            string(column<StringRef>(UserEmails)[index]),
+            string(column<StringRef>(UserPasswordHashes)[index])};
+}
+
+SnapshotFile::AdvertView SnapshotFile::advert(size_t index) const
+{
+    return {column<int32_t>(AdvertIds)[index],
+            column<int32_t>(AdvertOwnerIds)[index],
+            column<double>(AdvertPrices)[index],
+            static_cast<std::time_t>(column<int64_t>(AdvertCreatedAt)[index]),
+            string(column<StringRef>(AdvertTitles)[index]),
+            string(column<StringRef>(AdvertDescriptions)[index])};
+}
+
+std::pair<int, int> SnapshotFile::response(size_t index) const
+{
+    return {column<int32_t>(ResponseAdvertIds)[index], column<int32_t>(ResponseUserIds)[index]};
+}
+
+std::pair<std::string_view, int> SnapshotFile::session(size_t index) const
+{
+    return {string(column<StringRef>(SessionTokens)[index]), column<int32_t>(SessionUserIds)[index]};
+}
+
+bool SnapshotFile::write(const std::filesystem::path &path, const PersistedState &state)
+{
+    std::string strings;
+    const auto intern = [&strings](std::string_view value)
+    {
+        const StringRef ref{strings.size(), value.size()};
+        strings.append(value);
+        return ref;
+    };
+
+    std::vector<int32_t> userIds;
+    std::vector<StringRef> userNames, userEmails, userHashes;
+    for (const auto &user : state.users)
+    {
+        userIds.push_back(user.id);
+        userNames.push_back(intern(user.name));
+        userEmails.push_back(intern(user.email));
+        userHashes.push_back(intern(user.passwordHash));
+    }
+    std::vector<int32_t> advertIds, advertOwners;
+    std::vector<double> advertPrices;
+    std::vector<int64_t> advertCreated;
+    std::vector<StringRef> advertTitles, advertDescriptions;
+    for (const auto &advert : state.adverts)
+    {
+        advertIds.push_back(advert.id);
+        advertOwners.push_back(advert.ownerId);
+        advertPrices.push_back(advert.price);
+        advertCreated.push_back(static_cast<int64_t>(advert.createdAt));
+        advertTitles.push_back(intern(advert.title));
+        advertDescriptions.push_back(intern(advert.description));
+    }
+    std::vector<int32_t> responseAdverts, responseUsers;
+    for (const auto &[advertId, userId] : state.responses)
+    {
+        responseAdverts.push_back(advertId);
+        responseUsers.push_back(userId);
+    }
+    std::vector<StringRef> sessionTokens;
+    std::vector<int32_t> sessionUsers;
+    for (const auto &[token, userId] : state.sessions)
+    {
+        sessionTokens.push_back(intern(token));
+        sessionUsers.push_back(userId);
+    }
+
+    const std::pair<const void *, size_t> columns[kColumnCount] = {
+        {userIds.data(), userIds.size() * sizeof(int32_t)},
+        {userNames.data(), userNames.size() * sizeof(StringRef)},
+        {userEmails.data(), userEmails.size() * sizeof(StringRef)},
+        {userHashes.data(), userHashes.size() * sizeof(StringRef)},
+        {advertIds.data(), advertIds.size() * sizeof(int32_t)},
+        {advertOwners.data(), advertOwners.size() * sizeof(int32_t)},
+        {advertPrices.data(), advertPrices.size() * sizeof(double)},
+        {advertCreated.data(), advertCreated.size() * sizeof(int64_t)},
+        {advertTitles.data(), advertTitles.size() * sizeof(StringRef)},
+        {advertDescriptions.data(), advertDescriptions.size() * sizeof(StringRef)},
+        {responseAdverts.data(), responseAdverts.size() * sizeof(int32_t)},
+        {responseUsers.data(), responseUsers.size() * sizeof(int32_t)},
+        {sessionTokens.data(), sessionTokens.size() * sizeof(StringRef)},
+        {sessionUsers.data(), sessionUsers.size() * sizeof(int32_t)},
+        {strings.data(), strings.size()},
+    };
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.columnCount = kColumnCount;
+    header.userCount = state.users.size();
+    header.advertCount = state.adverts.size();
+    header.responseCount = state.responses.size();
+    header.sessionCount = state.sessions.size();
+    header.nextUserId = state.nextUserId;
+    header.nextAdvertId = state.nextAdvertId;
+    header.stringTableSize = strings.size();
+    size_t offset = alignUp(sizeof(Header));
+    for (size_t i = 0; i < kColumnCount; ++i)
+    {
+        header.columnOffsets[i] = offset;
+        offset = alignUp(offset + columns[i].second);
+    }
+
+    const auto temporary = path.string() + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::perror(temporary.c_str());
+        return false;
+    }
+    static const char padding[kAlignment] = {};
+    bool ok = writeAll(fd, &header, sizeof(header)) &&
+              writeAll(fd, padding, alignUp(sizeof(Header)) - sizeof(Header));
+    for (size_t i = 0; ok && i < kColumnCount; ++i)
+    {
+        ok = writeAll(fd, columns[i].first, columns[i].second) &&
+             writeAll(fd, padding, alignUp(columns[i].second) - columns[i].second);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+    std::error_code ec;
+    if (ok)
+    {
+        std::filesystem::rename(temporary, path, ec);
+        ok = !ec && syncParentDirectory(path);
+    }
+    if (!ok)
+    {
+        std::cerr << "Failed to write snapshot " << path << std::endl;
+        std::filesystem::remove(temporary, ec);
+    }
+    return ok;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "persistence.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+// Columnar image of the board that is used in place through mmap: one array
+// per field (ids, owner ids, prices, ...) plus a shared string table that the
+// string columns point into. Nothing is parsed on open beyond a bounds check,
+// so a server can start from millions of adverts without decoding them.
+class SnapshotFile
+{
+public:
+    struct UserView
+    {
+        int id;
+        std::string_view name;
+        std::string_view email;
+        std::string_view passwordHash;
+    };
+
+    struct AdvertView
+    {
+        int id;
+        int ownerId;
+        double price;
+        std::time_t createdAt;
+        std::string_view title;
+        std::string_view description;
+    };
+
+    // Writes `state` in this format, atomically replacing `path`.
+    static bool write(const std::filesystem::path &path, const PersistedState &state);
+
+    // Maps and validates `path`; null (with a message on stderr) if it is
+    // missing, truncated or not a snapshot.
+    static std::unique_ptr<SnapshotFile> open(const std::filesystem::path &path);
+    ~SnapshotFile();
+
+    SnapshotFile(const SnapshotFile &) = delete;
+    SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+    [[nodiscard]] size_t userCount() const;
+    [[nodiscard]] size_t advertCount() const;
+    [[nodiscard]] size_t responseCount() const;
+    [[nodiscard]] size_t sessionCount() const;
+    [[nodiscard]] int nextUserId() const;
+    [[nodiscard]] int nextAdvertId() const;
+
+    [[nodiscard]] UserView user(size_t index) const;
+    [[nodiscard]] AdvertView advert(size_t index) const;
+    [[nodiscard]] std::pair<int, int> response(size_t index) const; // (advert id, user id)
+    [[nodiscard]] std::pair<std::string_view, int> session(size_t index) const;
+
+private:
+    struct Header;
+    struct StringRef;
+
+    SnapshotFile(const char *data, size_t size) : data_(data), size_(size) {}
+
+    [[nodiscard]] const Header &header() const;
+    template <typename T>
+    [[nodiscard]] const T *column(size_t index) const;
+    [[nodiscard]] std::string_view string(const StringRef &ref) const;
+    [[nodiscard]] bool validate() const;
+
+    const char *data_;
+    size_t size_;
+};
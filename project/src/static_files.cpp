@@ -0,0 +1,358 @@
+#include "static_files.hpp"
+
+#include "http.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#ifdef BB_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    // Smaller files gain nothing from compression once headers are counted.
+    constexpr size_t kMinCompressSize = 256;
+    // Maximum-quality brotli takes seconds on multi-megabyte inputs.
+    constexpr size_t kMaxCompressSize = 1 << 20;
+    // Below this a second syscall for sendfile costs more than copying.
+    constexpr size_t kSendfileMinSize = 8 * 1024;
+    constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+    std::string readFile(const std::filesystem::path &path, bool &ok)
+    {
+        std::ifstream input(path, std::ios::binary);
+        ok = static_cast<bool>(input);
+        std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        ok = ok && !input.bad();
+        return content;
+    }
+
+    std::string guessMimeType(const std::filesystem::path &path)
+    {
+        const auto ext = path.extension().string();
+        if (ext == ".html")
+            return "text/html; charset=utf-8";
+        if (ext == ".css")
+            return "text/css; charset=utf-8";
+        if (ext == ".js")
+            return "application/javascript; charset=utf-8";
+        if (ext == ".json")
+            return "application/json; charset=utf-8";
+        if (ext == ".png")
+            return "image/png";
+        if (ext == ".jpg" || ext == ".jpeg")
+            return "image/jpeg";
+        if (ext == ".svg")
+            return "image/svg+xml";
+        if (ext == ".ico")
+            return "image/x-icon";
+        return "text/plain; charset=utf-8";
+    }
+
+    bool isCompressible(std::string_view contentType)
+    {
+        return contentType.rfind("text/", 0) == 0 || contentType.find("javascript") != std::string_view::npos ||
+               contentType.find("json") != std::string_view::npos || contentType.find("svg") != std::string_view::npos;
+    }
+
+    std::string makeEtag(std::string_view content, std::string_view suffix)
+    {
+        // FNV-1a over the identity bytes; variants share it plus a suffix.
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char ch : content)
+        {
+            hash = (hash ^ ch) * 1099511628211ull;
+        }
+        static constexpr char kHex[] = "0123456789abcdef";
+        std::string etag = "\"";
+        for (int shift = 60; shift >= 0; shift -= 4)
+        {
+            etag.push_back(kHex[(hash >> shift) & 0xF]);
+        }
+        etag.append(suffix);
+        etag.push_back('"');
+        return etag;
+    }
+
+    std::string gzipCompress(std::string_view input)
+    {
+        z_stream stream{};
+        // 15 window bits + 16 selects the gzip wrapper.
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return {};
+        }
+        std::string output(deflateBound(&stream, static_cast<uLong>(input.size())), '\0');
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        const int result = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END ? output : std::string{};
+    }
+
+    std::string brotliCompress(std::string_view input)
+    {
+#ifdef BB_HAVE_BROTLI
+        size_t size = BrotliEncoderMaxCompressedSize(input.size());
+        if (size == 0)
+        {
+            return {};
+        }
+        std::string output(size, '\0');
+        if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, input.size(),
+                                   reinterpret_cast<const uint8_t *>(input.data()), &size,
+                                   reinterpret_cast<uint8_t *>(output.data())))
+        {
+            return {};
+        }
+        output.resize(size);
+        return output;
+#else
+        (void)input;
+        return {};
+#endif
+    }
+
+    // Copies `content` into a sealed anonymous file, or returns null.
+    std::shared_ptr<const FileBody> makeFileBody(std::string_view content)
+    {
+        const int fd = memfd_create("bb-static", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        auto file = std::make_shared<const FileBody>(fd, content.size());
+        for (size_t written = 0; written < content.size();)
+        {
+            const ssize_t result = ::write(fd, content.data() + written, content.size() - written);
+            if (result <= 0)
+            {
+                return nullptr;
+            }
+            written += static_cast<size_t>(result);
+        }
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        return file;
+    }
+
+    StaticAsset::Variant makeVariant(std::string body, std::string etag)
+    {
+        StaticAsset::Variant variant;
+        variant.etag = std::move(etag);
+        if (body.size() >= kSendfileMinSize)
+        {
+            variant.file = makeFileBody(body);
+        }
+        if (!variant.file)
+        {
+            variant.body = std::make_shared<const std::string>(std::move(body));
+        }
+        return variant;
+    }
+}
+
+StaticFileCache::StaticFileCache(std::filesystem::path root) : root_(std::filesystem::absolute(std::move(root)))
+{
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0)
+    {
+        std::perror("inotify");
+    }
+    reload();
+    if (inotifyFd_ >= 0 && stopFd_ >= 0)
+    {
+        watcher_ = std::thread(&StaticFileCache::watch, this);
+    }
+}
+
+StaticFileCache::~StaticFileCache()
+{
+    if (watcher_.joinable())
+    {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto written = ::write(stopFd_, &one, sizeof(one));
+        watcher_.join();
+    }
+    if (inotifyFd_ >= 0)
+    {
+        ::close(inotifyFd_);
+    }
+    if (stopFd_ >= 0)
+    {
+        ::close(stopFd_);
+    }
+}
+
+std::shared_ptr<const StaticAsset> StaticFileCache::find(std::string_view path) const
+{
+    if (path.empty())
+    {
+        path = "/";
+    }
+    std::shared_ptr<const AssetMap> assets;
+    {
+        std::lock_guard lock(mutex_);
+        assets = assets_;
+    }
+    if (auto it = assets->find(std::string(path)); it != assets->end())
+    {
+        return it->second;
+    }
+    return nullptr;
+}
+
+void StaticFileCache::reload()
+{
+    auto assets = std::make_shared<AssetMap>();
+    std::error_code ec;
+    if (inotifyFd_ >= 0)
+    {
+        inotify_add_watch(inotifyFd_, root_.c_str(), kWatchMask);
+    }
+    for (std::filesystem::recursive_directory_iterator it(root_, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const auto &entry = *it;
+        // Symlinks could point outside the root; only serve what is really here.
+        if (entry.is_symlink(ec))
+        {
+            continue;
+        }
+        if (entry.is_directory(ec))
+        {
+            if (inotifyFd_ >= 0)
+            {
+                inotify_add_watch(inotifyFd_, entry.path().c_str(), kWatchMask);
+            }
+            continue;
+        }
+        if (!entry.is_regular_file(ec))
+        {
+            continue;
+        }
+
+        bool ok = false;
+        auto content = readFile(entry.path(), ok);
+        if (!ok)
+        {
+            continue;
+        }
+        auto asset = std::make_shared<StaticAsset>();
+        asset->contentType = guessMimeType(entry.path());
+        if (content.size() >= kMinCompressSize && content.size() <= kMaxCompressSize &&
+            isCompressible(asset->contentType))
+        {
+            // Keep a compressed variant only if it is actually smaller.
+            if (auto gzip = gzipCompress(content); !gzip.empty() && gzip.size() < content.size())
+            {
+                asset->gzip = makeVariant(std::move(gzip), makeEtag(content, "-gzip"));
+            }
+            if (auto brotli = brotliCompress(content); !brotli.empty() && brotli.size() < content.size())
+            {
+                asset->brotli = makeVariant(std::move(brotli), makeEtag(content, "-br"));
+            }
+        }
+        auto etag = makeEtag(content, "");
+        asset->identity = makeVariant(std::move(content), std::move(etag));
+
+        const auto key = "/" + entry.path().lexically_relative(root_).generic_string();
+        if (key == "/index.html")
+        {
+            (*assets)["/"] = asset;
+        }
+        (*assets)[key] = std::move(asset);
+    }
+
+    std::lock_guard lock(mutex_);
+    assets_ = std::move(assets);
+}
+
+void StaticFileCache::watch()
+{
+    pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    alignas(inotify_event) char buffer[4096];
+    while (true)
+    {
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::perror("poll");
+            return;
+        }
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+        // Editors touch several files in a burst; drain it and reload once.
+        bool changed = false;
+        while (::read(inotifyFd_, buffer, sizeof(buffer)) > 0)
+        {
+            changed = true;
+        }
+        if (changed)
+        {
+            reload();
+        }
+    }
+}
+
+void StaticAsset::Variant::attachTo(HttpResponse &response) const
+{
+    response.body.clear();
+    response.sharedBody = body;
+    response.file = file;
+}
+
+const StaticAsset::Variant &selectVariant(const StaticAsset &asset, std::string_view acceptEncoding,
+                                          const char *&contentEncoding)
+{
+    if (!asset.brotli.empty() && acceptsEncoding(acceptEncoding, "br"))
+    {
+        contentEncoding = "br";
+        return asset.brotli;
+    }
+    if (!asset.gzip.empty() && acceptsEncoding(acceptEncoding, "gzip"))
+    {
+        contentEncoding = "gzip";
+        return asset.gzip;
+    }
+    contentEncoding = nullptr;
+    return asset.identity;
+}
+
+bool etagMatches(std::string_view ifNoneMatch, std::string_view etag)
+{
+    const auto opaque = [](std::string_view tag)
+    {
+        return tag.rfind("W/", 0) == 0 ? tag.substr(2) : tag;
+    };
+    while (!ifNoneMatch.empty())
+    {
+        const auto comma = ifNoneMatch.find(',');
+        const auto candidate = trim(ifNoneMatch.substr(0, comma));
+        ifNoneMatch = comma == std::string_view::npos ? std::string_view{} : ifNoneMatch.substr(comma + 1);
+        if (candidate == "*" || opaque(candidate) == opaque(etag))
+        {
+            return true;
+        }
+    }
+    return false;
+}
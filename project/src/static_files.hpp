@@ -0,0 +1,70 @@
+#pragma once
+
+#include "http.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+// One file under the static root, read once, with its precompressed variants.
+// An empty variant means compressing did not make the file smaller.
+struct StaticAsset
+{
+    // Small bodies stay in memory and go out in the same write as the headers;
+    // larger ones live in a sealed memfd and are sent with sendfile(2).
+    struct Variant
+    {
+        std::shared_ptr<const std::string> body;
+        std::shared_ptr<const FileBody> file;
+        std::string etag; // strong, quoted
+
+        [[nodiscard]] bool empty() const { return !body && !file; }
+        void attachTo(HttpResponse &response) const;
+    };
+
+    std::string contentType;
+    Variant identity;
+    Variant gzip;
+    Variant brotli;
+};
+
+// Every regular file under `root`, keyed by request path ("/app.js"; "/" is
+// index.html). The whole tree is loaded up front and reloaded when inotify
+// reports a change; lookups never touch the file system.
+class StaticFileCache
+{
+public:
+    explicit StaticFileCache(std::filesystem::path root);
+    ~StaticFileCache();
+
+    StaticFileCache(const StaticFileCache &) = delete;
+    StaticFileCache &operator=(const StaticFileCache &) = delete;
+
+    [[nodiscard]] std::shared_ptr<const StaticAsset> find(std::string_view path) const;
+
+private:
+    using AssetMap = std::unordered_map<std::string, std::shared_ptr<const StaticAsset>>;
+
+    void reload();
+    void watch();
+
+    std::filesystem::path root_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const AssetMap> assets_;
+
+    int inotifyFd_ = -1;
+    int stopFd_ = -1;
+    std::thread watcher_;
+};
+
+// Picks the variant to send for an Accept-Encoding value (brotli, then gzip,
+// then identity) and names its Content-Encoding, or nullptr for identity.
+const StaticAsset::Variant &selectVariant(const StaticAsset &asset, std::string_view acceptEncoding,
+                                          const char *&contentEncoding);
+
+// Whether an If-None-Match value lists `etag` (weak comparison) or is "*".
+bool etagMatches(std::string_view ifNoneMatch, std::string_view etag);
@@ -0,0 +1,355 @@
+#include "store.hpp"
+
+#include <climits>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+    // Appends ids from an ordered (key, id) index to `page`, starting after
+    // `after` and staying within [lo, hi] on the key.
+    template <typename Key, typename Match>
+    void collectPage(const std::set<std::pair<Key, int>> &index, bool descending,
+                     const std::optional<std::pair<Key, int>> &after,
+                     const std::optional<Key> &lo, const std::optional<Key> &hi,
+                     size_t limit, Match &&match, std::vector<int> &page, bool &hasMore)
+    {
+        const auto take = [&](int id)
+        {
+            if (!match(id))
+            {
+                return true;
+            }
+            if (page.size() == limit)
+            {
+                hasMore = true;
+                return false;
+            }
+            page.push_back(id);
+            return true;
+        };
+
+        if (!descending)
+        {
+            auto it = lo ? index.lower_bound({*lo, INT_MIN}) : index.begin();
+            if (after)
+            {
+                // Start from whichever bound is later.
+                auto resume = index.upper_bound(*after);
+                if (resume == index.end() || (it != index.end() && *it < *resume))
+                {
+                    it = resume;
+                }
+            }
+            for (; it != index.end(); ++it)
+            {
+                if ((hi && it->first > *hi) || !take(it->second))
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            auto it = hi ? index.upper_bound({*hi, INT_MAX}) : index.end();
+            if (after)
+            {
+                // Walk back from whichever bound is earlier.
+                auto resume = index.lower_bound(*after);
+                if (resume != index.end() && (it == index.end() || *resume < *it))
+                {
+                    it = resume;
+                }
+            }
+            while (it != index.begin())
+            {
+                --it;
+                if ((lo && it->first < *lo) || !take(it->second))
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+const Advertisement *AdvertStore::find(int id) const
+{
+    if (auto it = index_.find(id); it != index_.end())
+    {
+        return &slots_[it->second].advert;
+    }
+    return nullptr;
+}
+
+void AdvertStore::reserve(size_t count)
+{
+    slots_.reserve(count);
+    index_.reserve(count);
+}
+
+const Advertisement &AdvertStore::insert(Advertisement advert)
+{
+    uint32_t slot;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+
+    auto &entry = slots_[slot];
+    entry.advert = std::move(advert);
+    entry.prev = tail_;
+    entry.next = kNoSlot;
+    if (tail_ != kNoSlot)
+    {
+        slots_[tail_].next = slot;
+    }
+    else
+    {
+        head_ = slot;
+    }
+    tail_ = slot;
+
+    const auto &stored = entry.advert;
+    index_[stored.id] = slot;
+    // Adverts normally arrive in creation order, so the end is a good hint.
+    byCreated_.emplace_hint(byCreated_.end(), stored.createdAt, stored.id);
+    byPrice_.emplace(stored.price, stored.id);
+    auto &owned = byOwner_[stored.ownerId];
+    owned.emplace_hint(owned.end(), stored.createdAt, stored.id);
+    return stored;
+}
+
+const Advertisement &AdvertStore::restore(Advertisement advert)
+{
+    const auto successor = byCreated_.upper_bound({advert.createdAt, advert.id});
+    const uint32_t before = successor == byCreated_.end() ? kNoSlot : index_.at(successor->second);
+    insert(std::move(advert));
+    const uint32_t slot = tail_;
+    if (before == kNoSlot)
+    {
+        return slots_[slot].advert;
+    }
+
+    // insert() appended it; move it in front of its successor.
+    auto &entry = slots_[slot];
+    tail_ = entry.prev;
+    slots_[tail_].next = kNoSlot;
+    entry.prev = slots_[before].prev;
+    entry.next = before;
+    if (entry.prev != kNoSlot)
+    {
+        slots_[entry.prev].next = slot;
+    }
+    else
+    {
+        head_ = slot;
+    }
+    slots_[before].prev = slot;
+    return entry.advert;
+}
+
+bool AdvertStore::erase(int id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end())
+    {
+        return false;
+    }
+    const uint32_t slot = it->second;
+    index_.erase(it);
+
+    auto &entry = slots_[slot];
+    const auto &advert = entry.advert;
+    byCreated_.erase({advert.createdAt, advert.id});
+    byPrice_.erase({advert.price, advert.id});
+    if (auto owner = byOwner_.find(advert.ownerId); owner != byOwner_.end())
+    {
+        owner->second.erase({advert.createdAt, advert.id});
+        if (owner->second.empty())
+        {
+            byOwner_.erase(owner);
+        }
+    }
+
+    if (entry.prev != kNoSlot)
+    {
+        slots_[entry.prev].next = entry.next;
+    }
+    else
+    {
+        head_ = entry.next;
+    }
+    if (entry.next != kNoSlot)
+    {
+        slots_[entry.next].prev = entry.prev;
+    }
+    else
+    {
+        tail_ = entry.prev;
+    }
+
+    // Release the strings now rather than when the slot is reused.
+    entry = Slot{};
+    freeSlots_.push_back(slot);
+    return true;
+}
+
+AdvertPage AdvertStore::query(const AdvertQuery &query) const
+{
+    const auto matches = [&](int id)
+    {
+        const auto &advert = slots_[index_.at(id)].advert;
+        return (!query.ownerId || advert.ownerId == *query.ownerId) &&
+               (!query.minPrice || advert.price >= *query.minPrice) &&
+               (!query.maxPrice || advert.price <= *query.maxPrice);
+    };
+
+    std::vector<int> ids;
+    bool hasMore = false;
+    if (query.sort == AdvertQuery::Sort::PriceAsc || query.sort == AdvertQuery::Sort::PriceDesc)
+    {
+        collectPage(byPrice_, query.sort == AdvertQuery::Sort::PriceDesc, query.after,
+                    query.minPrice, query.maxPrice, query.limit, matches, ids, hasMore);
+    }
+    else
+    {
+        std::optional<CreatedKey> after;
+        if (query.after)
+        {
+            after = CreatedKey{static_cast<std::time_t>(query.after->first), query.after->second};
+        }
+        const std::set<CreatedKey> *index = &byCreated_;
+        if (query.ownerId)
+        {
+            auto owner = byOwner_.find(*query.ownerId);
+            if (owner == byOwner_.end())
+            {
+                return {};
+            }
+            index = &owner->second;
+        }
+        collectPage(*index, query.sort == AdvertQuery::Sort::Newest, after,
+                    std::optional<std::time_t>{}, std::optional<std::time_t>{}, query.limit, matches, ids, hasMore);
+    }
+
+    AdvertPage page;
+    page.hasMore = hasMore;
+    page.adverts.reserve(ids.size());
+    for (int id : ids)
+    {
+        page.adverts.push_back(&slots_[index_.at(id)].advert);
+    }
+    return page;
+}
+
+bool ResponseStore::add(int adId, int userId)
+{
+    auto &adShard = byAd_[shardIndex(adId)];
+    std::unique_lock adLock(adShard.mutex);
+    if (!adShard.responses[adId].insert(userId).second)
+    {
+        return false;
+    }
+    auto &userShard = byUser_[shardIndex(userId)];
+    std::unique_lock userLock(userShard.mutex);
+    userShard.responses[userId].insert(adId);
+    return true;
+}
+
+void ResponseStore::remove(int adId, int userId)
+{
+    auto &adShard = byAd_[shardIndex(adId)];
+    std::unique_lock adLock(adShard.mutex);
+    auto ad = adShard.responses.find(adId);
+    if (ad == adShard.responses.end() || ad->second.erase(userId) == 0)
+    {
+        return;
+    }
+    if (ad->second.empty())
+    {
+        adShard.responses.erase(ad);
+    }
+    auto &userShard = byUser_[shardIndex(userId)];
+    std::unique_lock userLock(userShard.mutex);
+    if (auto user = userShard.responses.find(userId); user != userShard.responses.end())
+    {
+        user->second.erase(adId);
+        if (user->second.empty())
+        {
+            userShard.responses.erase(user);
+        }
+    }
+}
+
+void ResponseStore::eraseAd(int adId)
+{
+    std::unordered_set<int> userIds;
+    {
+        auto &adShard = byAd_[shardIndex(adId)];
+        std::unique_lock lock(adShard.mutex);
+        auto it = adShard.responses.find(adId);
+        if (it == adShard.responses.end())
+        {
+            return;
+        }
+        userIds = std::move(it->second);
+        adShard.responses.erase(it);
+    }
+
+    for (int userId : userIds)
+    {
+        auto &userShard = byUser_[shardIndex(userId)];
+        std::unique_lock lock(userShard.mutex);
+        auto it = userShard.responses.find(userId);
+        if (it != userShard.responses.end())
+        {
+            it->second.erase(adId);
+            if (it->second.empty())
+            {
+                userShard.responses.erase(it);
+            }
+        }
+    }
+}
+
+ResponseStore::Summary ResponseStore::summary(int adId, int userId) const
+{
+    const auto &shard = byAd_[shardIndex(adId)];
+    std::shared_lock lock(shard.mutex);
+    Summary result;
+    if (auto it = shard.responses.find(adId); it != shard.responses.end())
+    {
+        result.count = it->second.size();
+        result.hasResponded = userId > 0 && it->second.count(userId) > 0;
+    }
+    return result;
+}
+
+std::vector<int> ResponseStore::responders(int adId) const
+{
+    const auto &shard = byAd_[shardIndex(adId)];
+    std::shared_lock lock(shard.mutex);
+    if (auto it = shard.responses.find(adId); it != shard.responses.end())
+    {
+        return {it->second.begin(), it->second.end()};
+    }
+    return {};
+}
+
+std::vector<int> ResponseStore::adsRespondedBy(int userId) const
+{
+    const auto &shard = byUser_[shardIndex(userId)];
+    std::shared_lock lock(shard.mutex);
+    if (auto it = shard.responses.find(userId); it != shard.responses.end())
+    {
+        return {it->second.begin(), it->second.end()};
+    }
+    return {};
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct User
+{
+    int id = 0;
+    std::string name;
+    std::string email;
+    std::string passwordHash;
+};
+
+struct Advertisement
+{
+    int id = 0;
+    int ownerId = 0;
+    std::string title;
+    std::string description;
+    double price = 0.0;
+    std::time_t createdAt = 0;
+};
+
+struct AdvertQuery
+{
+    enum class Sort
+    {
+        Oldest,
+        Newest,
+        PriceAsc,
+        PriceDesc,
+    };
+
+    Sort sort = Sort::Oldest;
+    std::optional<int> ownerId;
+    std::optional<double> minPrice;
+    std::optional<double> maxPrice;
+    // Continue strictly after this (sort key, id) position. The key must be
+    // finite and fit std::time_t; the API refuses other cursors.
+    std::optional<std::pair<double, int>> after;
+    size_t limit = std::numeric_limits<size_t>::max();
+};
+
+struct AdvertPage
+{
+    std::vector<const Advertisement *> adverts;
+    bool hasMore = false;
+};
+
+// Adverts live in slots reached through an id -> slot index, so lookup and
+// deletion are O(1). Freed slots are reused via a free list, and a linked list
+// through the live slots keeps iteration in creation order. Not synchronized;
+// callers hold the adverts lock.
+class AdvertStore
+{
+public:
+    [[nodiscard]] const Advertisement *find(int id) const;
+    const Advertisement &insert(Advertisement advert);
+    // Puts back an advert that was erased, at its place in creation order
+    // rather than at the end.
+    const Advertisement &restore(Advertisement advert);
+    bool erase(int id);
+    [[nodiscard]] size_t size() const { return index_.size(); }
+    // Pre-sizes storage before a bulk load.
+    void reserve(size_t count);
+
+    // Walks the ordered index matching the sort (the owner's own index when
+    // filtering by owner), so a page costs O(log n + scanned). A price range
+    // is an index range under price sorts and a filter otherwise.
+    [[nodiscard]] AdvertPage query(const AdvertQuery &query) const;
+
+    template <typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        for (uint32_t slot = head_; slot != kNoSlot; slot = slots_[slot].next)
+        {
+            fn(slots_[slot].advert);
+        }
+    }
+
+private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    struct Slot
+    {
+        Advertisement advert;
+        uint32_t prev = kNoSlot;
+        uint32_t next = kNoSlot;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    std::unordered_map<int, uint32_t> index_;
+    uint32_t head_ = kNoSlot;
+    uint32_t tail_ = kNoSlot;
+
+    using CreatedKey = std::pair<std::time_t, int>;
+    using PriceKey = std::pair<double, int>;
+    std::set<CreatedKey> byCreated_;
+    std::set<PriceKey> byPrice_;
+    std::unordered_map<int, std::set<CreatedKey>> byOwner_;
+};
+
+// Maps are split into independently locked shards so that writes for
+// different keys (advert ids, user ids) do not contend with each other.
+constexpr size_t kStoreShardCount = 16;
+
+// Responses keyed by advert id: which users responded to which advert, plus
+// the reverse user -> adverts index so a user's own responses cost O(k).
+// Advert shards are always locked before user shards.
+class ResponseStore
+{
+public:
+    struct Summary
+    {
+        size_t count = 0;
+        bool hasResponded = false;
+    };
+
+    // Returns false if the user has already responded to this advert.
+    bool add(int adId, int userId);
+    void remove(int adId, int userId);
+    void eraseAd(int adId);
+
+    [[nodiscard]] Summary summary(int adId, int userId) const;
+    [[nodiscard]] std::vector<int> responders(int adId) const;
+    [[nodiscard]] std::vector<int> adsRespondedBy(int userId) const;
+
+    // Visits every (advert id, user id) pair, one advert shard at a time.
+    template <typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        for (const auto &shard : byAd_)
+        {
+            std::shared_lock lock(shard.mutex);
+            for (const auto &[adId, userIds] : shard.responses)
+            {
+                for (int userId : userIds)
+                {
+                    fn(adId, userId);
+                }
+            }
+        }
+    }
+
+private:
+    struct Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<int, std::unordered_set<int>> responses;
+    };
+
+    static size_t shardIndex(int id) { return static_cast<unsigned>(id) % kStoreShardCount; }
+
+    // Both directions share the layout: id -> set of ids on the other side.
+    std::array<Shard, kStoreShardCount> byAd_;
+    std::array<Shard, kStoreShardCount> byUser_;
+};
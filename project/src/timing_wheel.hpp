@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese & Lauck): four levels of 64 slots, each
+// slot of a level spanning a full turn of the level below. Scheduling and
+// firing are O(1) per item; an item is moved down at most once per level.
+// With one-second ticks the wheel covers about 194 days; later deadlines are
+// parked in the top level and re-placed whenever they come round.
+template <typename T>
+class TimingWheel
+{
+public:
+    explicit TimingWheel(uint64_t now = 0) : current_(now) {}
+
+    // Deadlines at or before the current tick fire on the next advance().
+    void schedule(uint64_t deadline, T value)
+    {
+        place(deadline > current_ ? deadline : current_ + 1, std::move(value));
+    }
+
+    // Moves the wheel to `now`, calling fire(T&) for every item that is due.
+    template <typename Fn>
+    void advance(uint64_t now, Fn &&fire)
+    {
+        while (current_ < now)
+        {
+            ++current_;
+            // When a level wraps, spread the next slot of the level above over it.
+            for (unsigned level = 1; level < kLevels; ++level)
+            {
+                if ((current_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0)
+                {
+                    break;
+                }
+                auto items = std::move(slots_[level][slotIndex(current_, level)]);
+                slots_[level][slotIndex(current_, level)].clear();
+                for (auto &[deadline, value] : items)
+                {
+                    place(deadline, std::move(value));
+                }
+            }
+
+            auto due = std::move(slots_[0][slotIndex(current_, 0)]);
+            slots_[0][slotIndex(current_, 0)].clear();
+            for (auto &[deadline, value] : due)
+            {
+                fire(value);
+            }
+        }
+    }
+
+    [[nodiscard]] uint64_t now() const { return current_; }
+
+private:
+    static constexpr unsigned kLevels = 4;
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+    static size_t slotIndex(uint64_t tick, unsigned level)
+    {
+        return static_cast<size_t>(tick >> (kSlotBits * level)) & (kSlots - 1);
+    }
+
+    // Puts the item on the lowest level whose current turn contains the
+    // deadline, so it reaches level 0 exactly when its slot comes up.
+    void place(uint64_t deadline, T value)
+    {
+        if (deadline <= current_)
+        {
+            slots_[0][slotIndex(current_, 0)].emplace_back(deadline, std::move(value));
+            return;
+        }
+        for (unsigned level = 0; level + 1 < kLevels; ++level)
+        {
+            const unsigned shift = kSlotBits * (level + 1);
+            if ((deadline >> shift) == (current_ >> shift))
+            {
+                slots_[level][slotIndex(deadline, level)].emplace_back(deadline, std::move(value));
+                return;
+            }
+        }
+        // The top level has nothing above it to wrap into, so it goes by
+        // distance; deadlines more than a turn away park in its last slot
+        // and are re-placed from there.
+        const unsigned top = kLevels - 1;
+        const uint64_t ahead = std::min<uint64_t>((deadline >> (kSlotBits * top)) - (current_ >> (kSlotBits * top)),
+                                                  kSlots - 1);
+        slots_[top][(slotIndex(current_, top) + ahead) & (kSlots - 1)].emplace_back(deadline, std::move(value));
+    }
+
+    uint64_t current_;
+    std::array<std::array<std::vector<std::pair<uint64_t, T>>, kSlots>, kLevels> slots_;
+};